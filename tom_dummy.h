@@ -1,7 +1,11 @@
 #ifndef __TOM_DUMMY_H__
 #define __TOM_DUMMY_H__
 
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
 #include <linux/platform_device.h>
+#include <linux/string.h>
 #include <sound/soc.h>
 
 #define TOM_DUMMY_CARD_NAME          "Tom Dummy ASoC Card"
@@ -17,6 +21,16 @@
 /* Platform (PCM) */
 #define TOM_DUMMY_PLATFORM_DRV_NAME  "tom-dummy-platform"
 #define LOOPBACK_BUFFER_SIZE          (64 * 1024)
+#define LOOPBACK_BUFFER_SIZE_MAX      (4 * 1024 * 1024)
+#define TOM_DUMMY_SILENCE_CHUNK       1024
+
+/* DPCM front-ends (registered by the platform) mixed into one back-end */
+#define TOM_DUMMY_NUM_FE              4
+#define TOM_DUMMY_FE_DAI_NAME(n)      "tom-dummy-fe-dai." #n
+#define TOM_DUMMY_FE_PLAYBACK(n)      "Tom FE" #n " Playback"
+#define TOM_DUMMY_FE_CAPTURE(n)       "Tom FE" #n " Capture"
+#define TOM_DUMMY_BE_PLAYBACK         "Tom CPU Playback"
+#define TOM_DUMMY_BE_CAPTURE          "Tom CPU Capture"
 
 /* 1kHz Sine Wave @ 48kHz Sample Rate (48 samples per cycle) */
 static const s16 sine_1k_48k_table[48] = {
@@ -26,16 +40,463 @@ static const s16 sine_1k_48k_table[48] = {
     -15814, -15882, -15635, -15077, -14217, -13069, -11654, -10000, -8142, -6116, -3962, -1728
 };
 
+#define TOM_DUMMY_CHANNELS            2
+
+/* Level of the most recently committed stretch of loopback mix, per channel */
+struct tom_dummy_levels {
+    u32 peak[TOM_DUMMY_CHANNELS];
+    u64 sumsq[TOM_DUMMY_CHANNELS];
+    u32 frames;
+};
+
+/*
+ * Read-only mmap tap (debugfs "<device>/loopback_tap"). The mapping is one
+ * header page followed by the ring itself:
+ *
+ *   offset 0          struct tom_dummy_tap_hdr
+ *   offset PAGE_SIZE  ring_size bytes of S16_LE stereo audio
+ *
+ * Ring offset of position p is (p & (ring_size - 1)). head is the furthest
+ * byte any front-end is mixing and committed <= head the end of the
+ * finished mix, so bytes in [head - ring_size, committed) are complete.
+ * head is published before a writer overwrites or marks silent anything
+ * it covers. To take a window [a, b) with b <= committed, copy it, then
+ * re-read head: if head - ring_size > a by then, part of the copy may
+ * have been overwritten and must be dropped. Re-checking committed is not
+ * enough: with several front-ends head runs ahead of it.
+ *
+ * silent[] is the silence marker bitmap (kernel unsigned long words, one
+ * bit per chunk_size bytes of ring): a chunk whose bit is set reads as
+ * zeros whatever the ring memory holds.
+ */
+#define TOM_DUMMY_TAP_VERSION         2
+
+struct tom_dummy_tap_hdr {
+    __u32 version;
+    __u32 ring_size;
+    __u64 head;
+    __u64 committed;
+    __u32 chunk_size;
+    __u32 reserved;
+    __u64 silent[];
+};
+
+/* A stream's place in the loopback ring, protected by loopback_lock */
+struct tom_dummy_cursor {
+    struct list_head node;
+    u64 pos;
+    bool active;
+    unsigned long underruns;
+    unsigned long overruns;
+};
+
+/*
+ * Loopback ring. Positions are free-running byte counts; the ring offset
+ * is (pos & (loopback_size - 1)), loopback_size being a power of two.
+ * Every playback front-end owns its own write cursor and saturating-adds
+ * its periods into the ring, so several producers are mixed rather than
+ * interleaved. loopback_head is the furthest byte any writer has touched:
+ * bytes past it are stale and are marked silent before the first writer
+ * mixes into them.
+ *
+ * Capture streams are readers with independent cursors: each one sees the
+ * whole signal. loopback_tail is the slowest active reader, and writers
+ * may not run more than loopback_size ahead of it. Both lists hold
+ * struct tom_dummy_cursor.
+ */
 struct tom_dummy_dev {
     struct snd_soc_component *component;
 
     u8 *loopback_buf;
-    size_t loopback_wptr;
-    size_t loopback_rptr;
-    size_t loopback_filled;
+    size_t loopback_size;
+    u64 loopback_head;
+    u64 loopback_tail;
+    struct list_head loopback_writers;
+    struct list_head loopback_readers;
+    struct tom_dummy_levels levels;
+    u64 loopback_metered;
+    struct tom_dummy_tap_hdr *tap;
+    unsigned long *silent;
+
+    /* Rate shared by every stream with hw_params set (0: none yet) */
+    unsigned int loopback_rate;
+    unsigned int loopback_rate_users;
+
+    /* Shared start tick of the snd_pcm_link() group being triggered */
+    struct snd_pcm_group *link_group;
+    ktime_t link_start;
 
     spinlock_t loopback_lock;
 };
 
+/* Saturating add of four S16 lanes packed in a u64 (SWAR) */
+static inline u64 tom_dummy_sat_add4_s16(u64 a, u64 b)
+{
+    const u64 h = 0x8000800080008000ULL;
+    const u64 l = 0x7fff7fff7fff7fffULL;
+    u64 sum = ((a & l) + (b & l)) ^ ((a ^ b) & h);
+    u64 ovf = ~(a ^ b) & (a ^ sum) & h;
+    u64 sat = l + ((a & h) >> 15);
+    u64 mask = (ovf >> 15) * 0xffff;
+
+    return (sum & ~mask) | (sat & mask);
+}
+
+/* dst[i] = clamp(dst[i] + src[i]) over S16_LE samples */
+static inline void tom_dummy_mix_s16(u8 *dst, const u8 *src, size_t bytes)
+{
+    size_t i = 0;
+
+#ifdef __LITTLE_ENDIAN
+    for (; i + sizeof(u64) <= bytes; i += sizeof(u64)) {
+        u64 a, b;
+
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a = tom_dummy_sat_add4_s16(a, b);
+        memcpy(dst + i, &a, sizeof(a));
+    }
+#endif
+    for (; i + sizeof(__le16) <= bytes; i += sizeof(__le16)) {
+        __le16 a, b;
+        int sum;
+
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        sum = (s16)le16_to_cpu(a) + (s16)le16_to_cpu(b);
+        a = cpu_to_le16((u16)clamp(sum, S16_MIN, S16_MAX));
+        memcpy(dst + i, &a, sizeof(a));
+    }
+}
+
+static inline void tom_dummy_ring_mix(u8 *ring, size_t size, u64 pos,
+                                      const u8 *src, size_t bytes)
+{
+    size_t off = pos & (size - 1);
+    size_t chunk1 = min_t(size_t, bytes, size - off);
+
+    tom_dummy_mix_s16(ring + off, src, chunk1);
+    if (bytes > chunk1)
+        tom_dummy_mix_s16(ring, src + chunk1, bytes - chunk1);
+}
+
+/*
+ * Accumulate per-channel peak and sum of squares over interleaved stereo
+ * S16_LE frames. Two frames per iteration, with separate accumulators, so
+ * the reduction has no serial dependency between neighbouring samples.
+ */
+static inline void tom_dummy_levels_s16(const u8 *buf, size_t bytes,
+                                        struct tom_dummy_levels *lv)
+{
+    const size_t frame = TOM_DUMMY_CHANNELS * sizeof(s16);
+    size_t frames = bytes / frame;
+    u32 pk[4] = { lv->peak[0], lv->peak[1], 0, 0 };
+    u64 sq[4] = { 0, 0, 0, 0 };
+    size_t i, c;
+
+    for (i = 0; i + 2 <= frames; i += 2) {
+        __le16 smp[4];
+
+        memcpy(smp, buf + i * frame, sizeof(smp));
+        for (c = 0; c < 4; c++) {
+            s32 v = (s16)le16_to_cpu(smp[c]);
+
+            pk[c] = max_t(u32, pk[c], abs(v));
+            sq[c] += (u32)(v * v);
+        }
+    }
+    if (i < frames) {
+        __le16 smp[2];
+
+        memcpy(smp, buf + i * frame, sizeof(smp));
+        for (c = 0; c < 2; c++) {
+            s32 v = (s16)le16_to_cpu(smp[c]);
+
+            pk[c] = max_t(u32, pk[c], abs(v));
+            sq[c] += (u32)(v * v);
+        }
+    }
+
+    lv->peak[0] = max(pk[0], pk[2]);
+    lv->peak[1] = max(pk[1], pk[3]);
+    lv->sumsq[0] += sq[0] + sq[2];
+    lv->sumsq[1] += sq[1] + sq[3];
+    lv->frames += frames;
+}
+
+/*
+ * Silence markers: one bit per TOM_DUMMY_SILENCE_CHUNK of ring. A set bit
+ * means every byte of that chunk reads as zero and the ring memory itself
+ * is stale, so all-zero periods never have to be stored or copied.
+ */
+static inline size_t tom_dummy_ring_segment(size_t size, u64 pos,
+                                            size_t bytes, size_t *chunk)
+{
+    size_t off = pos & (size - 1);
+
+    *chunk = off / TOM_DUMMY_SILENCE_CHUNK;
+    return min_t(size_t, bytes,
+                 TOM_DUMMY_SILENCE_CHUNK - off % TOM_DUMMY_SILENCE_CHUNK);
+}
+
+/* Mark every chunk that starts inside [pos, pos + bytes) as silent */
+static inline void tom_dummy_ring_mark_silent(unsigned long *map, size_t size,
+                                              u64 pos, size_t bytes)
+{
+    u64 end = pos + bytes;
+    u64 p = round_up(pos, TOM_DUMMY_SILENCE_CHUNK);
+
+    for (; p < end; p += TOM_DUMMY_SILENCE_CHUNK)
+        __set_bit((p & (size - 1)) / TOM_DUMMY_SILENCE_CHUNK, map);
+}
+
+/* Turn silent chunks overlapping [pos, pos + bytes) back into real zeros */
+static inline void tom_dummy_ring_materialize(u8 *ring, unsigned long *map,
+                                              size_t size, u64 pos,
+                                              size_t bytes)
+{
+    size_t seg, chunk;
+
+    for (; bytes; pos += seg, bytes -= seg) {
+        seg = tom_dummy_ring_segment(size, pos, bytes, &chunk);
+        if (__test_and_clear_bit(chunk, map))
+            memset(ring + chunk * TOM_DUMMY_SILENCE_CHUNK, 0,
+                   TOM_DUMMY_SILENCE_CHUNK);
+    }
+}
+
+static inline void tom_dummy_ring_read(const u8 *ring,
+                                       const unsigned long *map,
+                                       size_t size, u64 pos,
+                                       u8 *dst, size_t bytes)
+{
+    size_t seg, chunk;
+
+    for (; bytes; pos += seg, dst += seg, bytes -= seg) {
+        seg = tom_dummy_ring_segment(size, pos, bytes, &chunk);
+        if (test_bit(chunk, map))
+            memset(dst, 0, seg);
+        else
+            memcpy(dst, ring + (pos & (size - 1)), seg);
+    }
+}
+
+static inline void tom_dummy_ring_levels(const u8 *ring,
+                                         const unsigned long *map,
+                                         size_t size, u64 pos, size_t bytes,
+                                         struct tom_dummy_levels *lv)
+{
+    size_t seg, chunk;
+
+    for (; bytes; pos += seg, bytes -= seg) {
+        seg = tom_dummy_ring_segment(size, pos, bytes, &chunk);
+        if (test_bit(chunk, map))
+            lv->frames += seg / (TOM_DUMMY_CHANNELS * sizeof(s16));
+        else
+            tom_dummy_levels_s16(ring + (pos & (size - 1)), seg, lv);
+    }
+}
+
+/*
+ * Cursor accounting. All of these run under loopback_lock and only touch
+ * positions, never ring memory, so the KUnit suite drives them directly.
+ */
+
+/*
+ * Oldest byte still being produced by an active writer. Capture may only
+ * consume up to here, otherwise it would read a mix some front-ends have
+ * not contributed to yet.
+ */
+static inline u64 tom_dummy_loopback_committed(struct tom_dummy_dev *dev)
+{
+    struct tom_dummy_cursor *w;
+    u64 committed = dev->loopback_head;
+
+    list_for_each_entry(w, &dev->loopback_writers, node)
+        committed = min(committed, w->pos);
+
+    return committed;
+}
+
+/*
+ * The tail follows the slowest active reader. With no reader attached it
+ * stays put, so audio played before capture starts is kept (up to the
+ * ring size) for the first reader.
+ */
+static inline void tom_dummy_loopback_update_tail(struct tom_dummy_dev *dev)
+{
+    struct tom_dummy_cursor *r;
+    u64 tail = U64_MAX;
+
+    if (list_empty(&dev->loopback_readers))
+        return;
+
+    list_for_each_entry(r, &dev->loopback_readers, node)
+        tail = min(tail, r->pos);
+
+    dev->loopback_tail = tail;
+}
+
+static inline void tom_dummy_loopback_join(struct tom_dummy_dev *dev,
+                                           struct tom_dummy_cursor *cur,
+                                           bool writer)
+{
+    if (cur->active)
+        return;
+
+    if (writer) {
+        /* Join at the leading edge so earlier audio is not mixed twice */
+        cur->pos = max(dev->loopback_head, dev->loopback_tail);
+        list_add_tail(&cur->node, &dev->loopback_writers);
+    } else {
+        /* Join at the oldest retained byte, never ahead of other readers */
+        cur->pos = dev->loopback_tail;
+        list_add_tail(&cur->node, &dev->loopback_readers);
+    }
+    cur->active = true;
+}
+
+/*
+ * Move a reader to where a writer joining now starts, dropping whatever
+ * backlog it would otherwise read first. A capture started together with
+ * its playback then hears that playback after exactly one period.
+ */
+static inline void tom_dummy_loopback_skip_backlog(struct tom_dummy_dev *dev,
+                                                   struct tom_dummy_cursor *cur)
+{
+    cur->pos = max(dev->loopback_head, dev->loopback_tail);
+    tom_dummy_loopback_update_tail(dev);
+}
+
+/* Returns false if the cursor was not attached */
+static inline bool tom_dummy_loopback_leave(struct tom_dummy_dev *dev,
+                                            struct tom_dummy_cursor *cur)
+{
+    if (!cur->active)
+        return false;
+
+    list_del_init(&cur->node);
+    cur->active = false;
+
+    /* A departing slow reader must not keep holding the writers back */
+    tom_dummy_loopback_update_tail(dev);
+    return true;
+}
+
+/* Push readers the writer is about to lap forward, charging an overrun */
+static inline void tom_dummy_loopback_drop_slow(struct tom_dummy_dev *dev,
+                                                u64 end)
+{
+    struct tom_dummy_cursor *r;
+    u64 oldest = end - dev->loopback_size;
+
+    list_for_each_entry(r, &dev->loopback_readers, node) {
+        if (r->pos < oldest) {
+            r->pos = oldest;
+            r->overruns++;
+        }
+    }
+
+    dev->loopback_tail = max(dev->loopback_tail, oldest);
+}
+
+/*
+ * Claim bytes at cur->pos for a writer and advance the head over them.
+ * A writer that has fallen more than a ring behind the head (another
+ * writer lapped it, e.g. after lost ticks) would mix stale audio into the
+ * next lap, so it is resynced to the head and charged an overrun first.
+ * Fails if the claim would overwrite bytes a reader still needs, unless
+ * drop is set, in which case the lapped readers are moved on. *fresh is
+ * set to the first claimed byte no writer has touched before. The caller
+ * mixes at cur->pos, then advances it.
+ */
+static inline bool tom_dummy_loopback_reserve(struct tom_dummy_dev *dev,
+                                              struct tom_dummy_cursor *cur,
+                                              size_t bytes, bool drop,
+                                              u64 *fresh)
+{
+    u64 end;
+
+    if (dev->loopback_head - cur->pos > dev->loopback_size) {
+        cur->pos = dev->loopback_head;
+        cur->overruns++;
+    }
+
+    end = cur->pos + bytes;
+    if (end - dev->loopback_tail > dev->loopback_size) {
+        if (!drop)
+            return false;
+        tom_dummy_loopback_drop_slow(dev, end);
+    }
+
+    *fresh = max(cur->pos, dev->loopback_head);
+    dev->loopback_head = max(dev->loopback_head, end);
+    return true;
+}
+
+/* Whether a reader can take bytes of finished mix; counts an underrun if not */
+static inline bool tom_dummy_loopback_readable(struct tom_dummy_dev *dev,
+                                               struct tom_dummy_cursor *cur,
+                                               size_t bytes)
+{
+    u64 committed = tom_dummy_loopback_committed(dev);
+
+    /* A reader lapped past a lagging writer sits beyond committed */
+    if (committed < cur->pos || committed - cur->pos < bytes) {
+        cur->underruns++;
+        return false;
+    }
+
+    return true;
+}
+
+/* Finished mix waiting for a reader, in bytes */
+static inline u64 tom_dummy_loopback_backlog(struct tom_dummy_dev *dev,
+                                             struct tom_dummy_cursor *cur)
+{
+    u64 committed = tom_dummy_loopback_committed(dev);
+
+    return cur->active && committed > cur->pos ? committed - cur->pos : 0;
+}
+
+/*
+ * Frames in flight for a stream "since" frames into a period of "period"
+ * frames. Playback: hw_ptr takes a whole period at each tick, so what is
+ * left of it is still playing out. Capture: writers deliver whole periods
+ * into the ring, so the finished mix waiting there (backlog) is all that
+ * is in flight, with no partial period on top. Applied to the position at
+ * the last tick, this keeps the delayed position monotonic.
+ */
+static inline u64 tom_dummy_inflight_frames(bool playback, u64 period,
+                                            u64 since, u64 backlog)
+{
+    return playback ? period - min(since, period) : backlog;
+}
+
+static inline void tom_dummy_loopback_consume(struct tom_dummy_dev *dev,
+                                              struct tom_dummy_cursor *cur,
+                                              size_t bytes)
+{
+    cur->pos += bytes;
+    tom_dummy_loopback_update_tail(dev);
+}
+
+/* Exported by the platform for the codec's level meters */
+void tom_dummy_platform_get_levels(struct tom_dummy_levels *lv);
+
+/* Time spent in the platform cancelling stream timers at teardown */
+struct tom_dummy_cancel_stats {
+    u64 count;
+    u64 total_ns;
+    u64 max_ns;
+};
+
+/* Exported by the platform for the stress module; reset zeroes them */
+void tom_dummy_platform_get_cancel_stats(struct tom_dummy_cancel_stats *st,
+                                         bool reset);
+
+/* Exported by the machine; NULL until the card is instantiated */
+struct snd_soc_card *tom_dummy_machine_get_card(void);
+
 #endif /* __TOM_DUMMY_H__ */
 
@@ -0,0 +1,166 @@
+#include <linux/gfp.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/nodemask.h>
+#include <linux/slab.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+
+#include "tom_dummy.h"
+
+/*
+ * NUMA copy benchmark for the loopback hot path. From one CPU it mixes
+ * periods into a ring and copies them back out, the same work the
+ * platform's hrtimer callback does, once with the ring on the CPU's own
+ * node and once per remote node. Runs at module load and prints a report.
+ *
+ * The ring is built from physically contiguous blocks allocated with
+ * alloc_pages_node(), each the size of the largest ring probe allocates,
+ * so it has the same TLB and memory profile as the driver's own ring
+ * while the whole can still be made larger than the LLC.
+ */
+
+#define TOM_BENCH_BLOCK_ORDER  get_order(LOOPBACK_BUFFER_SIZE_MAX)
+#define TOM_BENCH_BLOCK        (PAGE_SIZE << TOM_BENCH_BLOCK_ORDER)
+
+static int cpu;
+module_param(cpu, int, 0444);
+MODULE_PARM_DESC(cpu, "CPU that runs the copies (its node is \"local\")");
+
+static unsigned int period_kb = 4;
+module_param(period_kb, uint, 0444);
+MODULE_PARM_DESC(period_kb, "Period size in KiB");
+
+static unsigned int ring_mb = 64;
+module_param(ring_mb, uint, 0444);
+MODULE_PARM_DESC(ring_mb, "Ring size in MiB, in contiguous blocks like the driver's ring; keep it above the LLC size");
+
+static unsigned int loops = 20000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Periods mixed and read back per node");
+
+struct tom_bench_run {
+    int node;
+    u64 ns;
+};
+
+static long tom_bench_node(void *arg)
+{
+    struct tom_bench_run *run = arg;
+    size_t period = (size_t)period_kb * 1024;
+    unsigned int nblocks = DIV_ROUND_UP((size_t)ring_mb * 1024 * 1024,
+                                        TOM_BENCH_BLOCK);
+    struct page **blocks;
+    size_t off = 0;
+    u8 *src, *dst, *p;
+    ktime_t t0;
+    unsigned int b, i;
+    long ret = -ENOMEM;
+
+    blocks = kcalloc(nblocks, sizeof(*blocks), GFP_KERNEL);
+    src = kmalloc(period, GFP_KERNEL);
+    dst = kmalloc(period, GFP_KERNEL);
+    if (!blocks || !src || !dst)
+        goto out;
+
+    /* __GFP_THISNODE: a fallback to another node would void the comparison */
+    for (b = 0; b < nblocks; b++) {
+        blocks[b] = alloc_pages_node(run->node,
+                                     GFP_KERNEL | __GFP_ZERO | __GFP_THISNODE,
+                                     TOM_BENCH_BLOCK_ORDER);
+        if (!blocks[b])
+            goto out;
+    }
+
+    memset(src, 0x11, period);
+
+    t0 = ktime_get();
+    for (i = 0, b = 0; i < loops; i++) {
+        p = page_address(blocks[b]) + off;
+        tom_dummy_mix_s16(p, src, period);
+        memcpy(dst, p, period);
+
+        off += period;
+        if (off + period > TOM_BENCH_BLOCK) {
+            off = 0;
+            b = (b + 1) % nblocks;
+        }
+    }
+    run->ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+    ret = 0;
+out:
+    for (b = 0; blocks && b < nblocks; b++)
+        if (blocks[b])
+            __free_pages(blocks[b], TOM_BENCH_BLOCK_ORDER);
+    kfree(blocks);
+    kfree(src);
+    kfree(dst);
+    return ret;
+}
+
+static int __init tom_dummy_bench_init(void)
+{
+    struct tom_bench_run run;
+    u64 local_ns = 0;
+    u64 bytes;
+    int local, node;
+    long ret;
+
+    pr_info("tom_bench: init\n");
+
+    if (period_kb == 0 || ring_mb == 0 || loops == 0 ||
+        (size_t)period_kb * 1024 > (size_t)ring_mb * 1024 * 1024 ||
+        (size_t)period_kb * 1024 > TOM_BENCH_BLOCK)
+        return -EINVAL;
+    if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+        return -EINVAL;
+
+    local = cpu_to_node(cpu);
+    /* Each period is mixed in (read + write) and copied out (read) */
+    bytes = (u64)loops * period_kb * 1024 * 3;
+
+    pr_info("tom_bench: cpu %d (node %d), %u x %u KiB periods over a %u MiB ring\n",
+        cpu, local, loops, period_kb, ring_mb);
+
+    /* Local node first so the remote runs can be compared against it */
+    for (node = -1; node < MAX_NUMNODES; node = next_online_node(node)) {
+        run.node = node < 0 ? local : node;
+        if (node >= 0 && node == local)
+            continue;
+
+        ret = work_on_cpu(cpu, tom_bench_node, &run);
+        if (ret) {
+            pr_err("tom_bench: node %d failed: %ld\n", run.node, ret);
+            return ret;
+        }
+
+        if (node < 0)
+            local_ns = run.ns;
+
+        pr_info("tom_bench: ring on node %d (%s): %llu ns/period, %llu MB/s, %llu%% of local\n",
+            run.node, node < 0 ? "local" : "remote",
+            div_u64(run.ns, loops),
+            run.ns ? div64_u64(bytes * 1000, run.ns) : 0,
+            local_ns ? div64_u64(run.ns * 100, local_ns) : 100);
+    }
+
+    if (num_online_nodes() == 1)
+        pr_info("tom_bench: single NUMA node, no remote comparison available\n");
+
+    return 0;
+}
+
+static void __exit tom_dummy_bench_exit(void)
+{
+    pr_info("tom_bench: exit\n");
+}
+
+module_init(tom_dummy_bench_init);
+module_exit(tom_dummy_bench_exit);
+
+MODULE_DESCRIPTION("Tom Dummy loopback NUMA copy benchmark");
+MODULE_AUTHOR("Tom Hsieh");
+MODULE_LICENSE("GPL");
@@ -1,3 +1,5 @@
+#include <linux/int_sqrt.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <sound/core.h>
@@ -58,10 +60,60 @@ static int tom_dummy_vol_put(struct snd_kcontrol *kcontrol,
     return 0;
 }
 
+static int tom_dummy_level_info(struct snd_kcontrol *kcontrol,
+                                struct snd_ctl_elem_info *uinfo)
+{
+    uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+    uinfo->count = TOM_DUMMY_CHANNELS;
+    uinfo->value.integer.min = 0;
+    uinfo->value.integer.max = 32768;
+    return 0;
+}
+
+static int tom_dummy_peak_get(struct snd_kcontrol *kcontrol,
+                              struct snd_ctl_elem_value *ucontrol)
+{
+    struct tom_dummy_levels lv;
+    int ch;
+
+    tom_dummy_platform_get_levels(&lv);
+    for (ch = 0; ch < TOM_DUMMY_CHANNELS; ch++)
+        ucontrol->value.integer.value[ch] = lv.peak[ch];
+
+    return 0;
+}
+
+/* The square root is taken here, on read, to keep it off the timer path */
+static int tom_dummy_rms_get(struct snd_kcontrol *kcontrol,
+                             struct snd_ctl_elem_value *ucontrol)
+{
+    struct tom_dummy_levels lv;
+    int ch;
+
+    tom_dummy_platform_get_levels(&lv);
+    for (ch = 0; ch < TOM_DUMMY_CHANNELS; ch++)
+        ucontrol->value.integer.value[ch] = lv.frames ?
+            int_sqrt64(div_u64(lv.sumsq[ch], lv.frames)) : 0;
+
+    return 0;
+}
+
+#define TOM_DUMMY_LEVEL(xname, xget)                               \
+    {                                                              \
+        .iface  = SNDRV_CTL_ELEM_IFACE_MIXER,                      \
+        .name   = xname,                                           \
+        .access = SNDRV_CTL_ELEM_ACCESS_READ |                     \
+                  SNDRV_CTL_ELEM_ACCESS_VOLATILE,                  \
+        .info   = tom_dummy_level_info,                            \
+        .get    = xget,                                            \
+    }
+
 static const struct snd_kcontrol_new tom_dummy_controls[] = {
     SOC_SINGLE_EXT("Master Playback Volume",
                    SND_SOC_NOPM, 0, 100, 0,
                    tom_dummy_vol_get, tom_dummy_vol_put),
+    TOM_DUMMY_LEVEL("Loopback Peak Level", tom_dummy_peak_get),
+    TOM_DUMMY_LEVEL("Loopback RMS Level", tom_dummy_rms_get),
 };
 
 static const struct snd_kcontrol_new tom_dummy_dapm_controls[] = {
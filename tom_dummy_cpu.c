@@ -37,7 +37,7 @@ static struct snd_soc_dai_driver tom_dummy_cpu_dai = {
     .name = TOM_DUMMY_CPU_DAI_NAME,
 
     .playback = {
-        .stream_name  = "Tom CPU Playback",
+        .stream_name  = TOM_DUMMY_BE_PLAYBACK,
         .channels_min = 2,
         .channels_max = 2,
         .rates        = (SNDRV_PCM_RATE_44100 | SNDRV_PCM_RATE_48000),
@@ -45,7 +45,7 @@ static struct snd_soc_dai_driver tom_dummy_cpu_dai = {
     },
 
     .capture = {
-        .stream_name = "Tom CPU Capture",
+        .stream_name = TOM_DUMMY_BE_CAPTURE,
         .channels_min = 2,
         .channels_max = 2,
         .rates        = (SNDRV_PCM_RATE_44100 | SNDRV_PCM_RATE_48000),
@@ -0,0 +1,382 @@
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include "tom_dummy.h"
+
+/*
+ * KUnit cases for the loopback ring primitives in tom_dummy.h: the SWAR
+ * saturating mixer, free-running position wrap, silence markers, the
+ * level meter, the reader/writer cursor accounting and the in-flight
+ * frame estimate behind audio timestamps.
+ */
+
+#define TOM_TEST_RING    4096
+/* Free-running origin past 2^32, so cursor math is exercised in 64 bits */
+#define TOM_TEST_ORIGIN  (5ULL << 32)
+
+static u64 tom_test_lanes(s16 a, s16 b, s16 c, s16 d)
+{
+    return (u64)(u16)a | (u64)(u16)b << 16 |
+           (u64)(u16)c << 32 | (u64)(u16)d << 48;
+}
+
+static s16 tom_test_sample(const u8 *buf, size_t idx)
+{
+    __le16 v;
+
+    memcpy(&v, buf + idx * sizeof(v), sizeof(v));
+    return (s16)le16_to_cpu(v);
+}
+
+static void tom_test_fill(u8 *buf, size_t samples, s16 start)
+{
+    size_t i;
+
+    for (i = 0; i < samples; i++) {
+        __le16 v = cpu_to_le16((u16)(s16)(start + i));
+
+        memcpy(buf + i * sizeof(v), &v, sizeof(v));
+    }
+}
+
+static struct tom_dummy_dev *tom_test_dev(struct kunit *test)
+{
+    struct tom_dummy_dev *dev = kunit_kzalloc(test, sizeof(*dev), GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+
+    dev->loopback_size = TOM_TEST_RING;
+    dev->loopback_head = TOM_TEST_ORIGIN;
+    dev->loopback_tail = TOM_TEST_ORIGIN;
+    INIT_LIST_HEAD(&dev->loopback_writers);
+    INIT_LIST_HEAD(&dev->loopback_readers);
+    return dev;
+}
+
+/* One period through the same cursor steps as the platform's FIFO paths */
+static bool tom_test_write(struct tom_dummy_dev *dev,
+                           struct tom_dummy_cursor *w, size_t bytes, bool drop)
+{
+    u64 fresh;
+
+    if (!tom_dummy_loopback_reserve(dev, w, bytes, drop, &fresh))
+        return false;
+
+    w->pos += bytes;
+    return true;
+}
+
+static bool tom_test_read(struct tom_dummy_dev *dev,
+                          struct tom_dummy_cursor *r, size_t bytes)
+{
+    if (!tom_dummy_loopback_readable(dev, r, bytes))
+        return false;
+
+    tom_dummy_loopback_consume(dev, r, bytes);
+    return true;
+}
+
+static void tom_dummy_test_sat_add(struct kunit *test)
+{
+    u64 r;
+
+    r = tom_dummy_sat_add4_s16(tom_test_lanes(1, -1, 100, -100),
+                               tom_test_lanes(2, -2, 23, 0));
+    KUNIT_EXPECT_EQ(test, r, tom_test_lanes(3, -3, 123, -100));
+
+    /* Each lane clamps on its own, without carrying into its neighbour */
+    r = tom_dummy_sat_add4_s16(tom_test_lanes(S16_MAX, S16_MIN, 30000, -30000),
+                               tom_test_lanes(1, -1, 30000, -30000));
+    KUNIT_EXPECT_EQ(test, r,
+                    tom_test_lanes(S16_MAX, S16_MIN, S16_MAX, S16_MIN));
+
+    r = tom_dummy_sat_add4_s16(tom_test_lanes(S16_MAX, S16_MIN, 0, -1),
+                               tom_test_lanes(S16_MIN, S16_MAX, -1, 1));
+    KUNIT_EXPECT_EQ(test, r, tom_test_lanes(-1, -1, -1, 0));
+}
+
+static void tom_dummy_test_mix_tail(struct kunit *test)
+{
+    /* 7 samples: one SWAR word plus a 3-sample scalar tail */
+    u8 dst[14], src[14];
+    size_t i;
+
+    tom_test_fill(dst, 7, 32760);
+    tom_test_fill(src, 7, 5);
+    tom_dummy_mix_s16(dst, src, sizeof(dst));
+
+    for (i = 0; i < 7; i++)
+        KUNIT_EXPECT_EQ(test, tom_test_sample(dst, i),
+                        (s16)min_t(int, 32760 + i + 5 + i, S16_MAX));
+}
+
+static void tom_dummy_test_ring_wrap(struct kunit *test)
+{
+    u8 *ring = kunit_kzalloc(test, TOM_TEST_RING, GFP_KERNEL);
+    u8 *src = kunit_kzalloc(test, 256, GFP_KERNEL);
+    u8 *dst = kunit_kzalloc(test, 256, GFP_KERNEL);
+    unsigned long map[BITS_TO_LONGS(TOM_TEST_RING / TOM_DUMMY_SILENCE_CHUNK)] = {};
+    /* Free-running position far past 2^32, 64 bytes before the ring end */
+    u64 pos = (5ULL << 32) + TOM_TEST_RING - 64;
+
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ring);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dst);
+
+    /* Only chunk 0 starts inside the window; chunk 3 holds live bytes */
+    tom_dummy_ring_mark_silent(map, TOM_TEST_RING, pos, 256);
+    KUNIT_EXPECT_TRUE(test, test_bit(0, map));
+    KUNIT_EXPECT_FALSE(test, test_bit(1, map));
+    KUNIT_EXPECT_FALSE(test, test_bit(3, map));
+
+    /* A silent chunk reads as zeros whatever the ring memory holds */
+    memset(ring, 0xaa, TOM_DUMMY_SILENCE_CHUNK);
+    memset(dst, 0x55, 256);
+    tom_dummy_ring_read(ring, map, TOM_TEST_RING, pos, dst, 256);
+    KUNIT_EXPECT_PTR_EQ(test, memchr_inv(dst, 0, 256), NULL);
+
+    tom_dummy_ring_materialize(ring, map, TOM_TEST_RING, pos, 256);
+    KUNIT_EXPECT_FALSE(test, test_bit(0, map));
+    KUNIT_EXPECT_EQ(test, ring[TOM_DUMMY_SILENCE_CHUNK - 1], 0);
+
+    tom_test_fill(src, 128, -64);
+    tom_dummy_ring_mix(ring, TOM_TEST_RING, pos, src, 256);
+    tom_dummy_ring_mix(ring, TOM_TEST_RING, pos, src, 256);
+    tom_dummy_ring_read(ring, map, TOM_TEST_RING, pos, dst, 256);
+
+    KUNIT_EXPECT_EQ(test, tom_test_sample(dst, 0), -128);
+    KUNIT_EXPECT_EQ(test, tom_test_sample(dst, 31), -66);
+    KUNIT_EXPECT_EQ(test, tom_test_sample(dst, 32), -64);
+    KUNIT_EXPECT_EQ(test, tom_test_sample(dst, 127), 126);
+    /* Sample 32 is the first one stored at ring offset 0 */
+    KUNIT_EXPECT_EQ(test, tom_test_sample(ring, 0), -64);
+}
+
+static void tom_dummy_test_levels(struct kunit *test)
+{
+    /* Three stereo frames: L = 3, -4, 0  R = -32768, 0, 0 */
+    u8 buf[12];
+    struct tom_dummy_levels lv = {};
+
+    memcpy(buf, (__le16[]){ cpu_to_le16(3), cpu_to_le16((u16)S16_MIN),
+                            cpu_to_le16((u16)-4), cpu_to_le16(0),
+                            cpu_to_le16(0), cpu_to_le16(0) }, sizeof(buf));
+
+    tom_dummy_levels_s16(buf, sizeof(buf), &lv);
+
+    KUNIT_EXPECT_EQ(test, lv.frames, 3U);
+    KUNIT_EXPECT_EQ(test, lv.peak[0], 4U);
+    KUNIT_EXPECT_EQ(test, lv.peak[1], 32768U);
+    KUNIT_EXPECT_EQ(test, lv.sumsq[0], 25ULL);
+    KUNIT_EXPECT_EQ(test, lv.sumsq[1], 1ULL << 30);
+}
+
+static void tom_dummy_test_writers(struct kunit *test)
+{
+    struct tom_dummy_dev *dev = tom_test_dev(test);
+    struct tom_dummy_cursor a = {}, b = {};
+    const u64 o = TOM_TEST_ORIGIN;
+
+    tom_dummy_loopback_join(dev, &a, true);
+    KUNIT_EXPECT_EQ(test, a.pos, o);
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &a, 1024, false));
+    KUNIT_EXPECT_EQ(test, dev->loopback_head, o + 1024);
+    KUNIT_EXPECT_EQ(test, tom_dummy_loopback_committed(dev), o + 1024);
+
+    /* A late writer joins at the head instead of re-mixing old audio */
+    tom_dummy_loopback_join(dev, &b, true);
+    KUNIT_EXPECT_EQ(test, b.pos, o + 1024);
+
+    /* committed is held back by the slowest writer */
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &a, 1024, false));
+    KUNIT_EXPECT_EQ(test, dev->loopback_head, o + 2048);
+    KUNIT_EXPECT_EQ(test, tom_dummy_loopback_committed(dev), o + 1024);
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &b, 512, false));
+    KUNIT_EXPECT_EQ(test, tom_dummy_loopback_committed(dev), o + 1536);
+
+    /* Its departure releases everything the leader already mixed */
+    KUNIT_EXPECT_TRUE(test, tom_dummy_loopback_leave(dev, &b));
+    KUNIT_EXPECT_FALSE(test, tom_dummy_loopback_leave(dev, &b));
+    KUNIT_EXPECT_EQ(test, tom_dummy_loopback_committed(dev), o + 2048);
+
+    /* With no writer left, committed is the head */
+    KUNIT_EXPECT_TRUE(test, tom_dummy_loopback_leave(dev, &a));
+    KUNIT_EXPECT_TRUE(test, list_empty(&dev->loopback_writers));
+    KUNIT_EXPECT_EQ(test, tom_dummy_loopback_committed(dev), o + 2048);
+}
+
+static void tom_dummy_test_readers(struct kunit *test)
+{
+    struct tom_dummy_dev *dev = tom_test_dev(test);
+    struct tom_dummy_cursor w = {}, w2 = {}, r1 = {}, r2 = {}, r3 = {};
+    const u64 o = TOM_TEST_ORIGIN;
+
+    tom_dummy_loopback_join(dev, &w, true);
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, 2048, false));
+
+    /* With no reader the tail stays put: the first reader gets it all */
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o);
+    tom_dummy_loopback_join(dev, &r1, false);
+    KUNIT_EXPECT_EQ(test, r1.pos, o);
+    KUNIT_EXPECT_TRUE(test, tom_test_read(dev, &r1, 2048));
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o + 2048);
+
+    /* A second reader joins at the tail and has nothing to read yet */
+    tom_dummy_loopback_join(dev, &r2, false);
+    KUNIT_EXPECT_EQ(test, r2.pos, o + 2048);
+    KUNIT_EXPECT_FALSE(test, tom_test_read(dev, &r2, 1024));
+    KUNIT_EXPECT_EQ(test, r2.underruns, 1UL);
+
+    /* Each reader sees the same bytes; the tail follows the slowest */
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, 1024, false));
+    KUNIT_EXPECT_TRUE(test, tom_test_read(dev, &r2, 1024));
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o + 2048);
+    KUNIT_EXPECT_TRUE(test, tom_test_read(dev, &r1, 1024));
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o + 3072);
+
+    /* Bytes a joined writer has not mixed yet are not readable */
+    tom_dummy_loopback_join(dev, &w2, true);
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, 1024, false));
+    KUNIT_EXPECT_EQ(test, tom_dummy_loopback_committed(dev), o + 3072);
+    KUNIT_EXPECT_FALSE(test, tom_test_read(dev, &r2, 1024));
+    KUNIT_EXPECT_EQ(test, r2.underruns, 2UL);
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w2, 1024, false));
+    KUNIT_EXPECT_TRUE(test, tom_test_read(dev, &r2, 1024));
+
+    /* A departing slow reader stops holding the tail back */
+    KUNIT_EXPECT_TRUE(test, tom_dummy_loopback_leave(dev, &r1));
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o + 4096);
+
+    /* A linked capture skips the backlog and starts where writers join */
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, 1024, false));
+    tom_dummy_loopback_join(dev, &r3, false);
+    KUNIT_EXPECT_EQ(test, r3.pos, o + 4096);
+    tom_dummy_loopback_skip_backlog(dev, &r3);
+    KUNIT_EXPECT_EQ(test, r3.pos, o + 5120);
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o + 4096);
+}
+
+static void tom_dummy_test_lapping(struct kunit *test)
+{
+    struct tom_dummy_dev *dev = tom_test_dev(test);
+    struct tom_dummy_cursor w = {}, lag = {}, r = {};
+    const u64 o = TOM_TEST_ORIGIN;
+    u64 head;
+
+    tom_dummy_loopback_join(dev, &w, true);
+    tom_dummy_loopback_join(dev, &r, false);
+
+    /* The writer may fill exactly one ring ahead of the reader */
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, TOM_TEST_RING, false));
+
+    /* By default a period that would lap the reader is refused */
+    KUNIT_EXPECT_FALSE(test, tom_test_write(dev, &w, 1024, false));
+    KUNIT_EXPECT_EQ(test, w.pos, o + TOM_TEST_RING);
+    KUNIT_EXPECT_EQ(test, dev->loopback_head, o + TOM_TEST_RING);
+    KUNIT_EXPECT_EQ(test, r.overruns, 0UL);
+
+    /* With drop the reader is moved on and charged an overrun */
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, 1024, true));
+    KUNIT_EXPECT_EQ(test, r.pos, o + 1024);
+    KUNIT_EXPECT_EQ(test, r.overruns, 1UL);
+    KUNIT_EXPECT_EQ(test, dev->loopback_tail, o + 1024);
+    KUNIT_EXPECT_EQ(test, dev->loopback_head, o + TOM_TEST_RING + 1024);
+    KUNIT_EXPECT_TRUE(test, tom_test_read(dev, &r, TOM_TEST_RING));
+
+    /* A reader pushed past a lagging writer must not read unmixed bytes */
+    tom_dummy_loopback_join(dev, &lag, true);
+    KUNIT_EXPECT_EQ(test, lag.pos, o + TOM_TEST_RING + 1024);
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, TOM_TEST_RING, true));
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &w, 1024, true));
+    KUNIT_EXPECT_EQ(test, r.overruns, 2UL);
+    KUNIT_EXPECT_GT(test, r.pos, tom_dummy_loopback_committed(dev));
+    KUNIT_EXPECT_FALSE(test, tom_test_read(dev, &r, 1024));
+
+    /* Its next period resyncs it to the head rather than mixing a lap late */
+    head = dev->loopback_head;
+    KUNIT_EXPECT_TRUE(test, tom_test_write(dev, &lag, 1024, true));
+    KUNIT_EXPECT_EQ(test, lag.overruns, 1UL);
+    KUNIT_EXPECT_EQ(test, lag.pos, head + 1024);
+
+    /* ...so committed moves on and capture recovers */
+    KUNIT_EXPECT_LE(test, r.pos, tom_dummy_loopback_committed(dev));
+    KUNIT_EXPECT_TRUE(test, tom_test_read(dev, &r, 1024));
+}
+
+/*
+ * Successive LINK_ESTIMATED positions must never go backwards: the delay
+ * is applied to the tick-aligned position, never to an interpolated one.
+ */
+static void tom_dummy_test_estimated(struct kunit *test)
+{
+    const u64 period = 480, step = 48;
+    u64 frames_done, since, backlog, est, prev;
+    unsigned int tick;
+
+    /* Playback: hw_ptr jumps a period per tick, the delay unwinds it */
+    prev = 0;
+    for (tick = 0; tick < 4; tick++) {
+        frames_done = tick * period;
+        for (since = 0; since <= period; since += step) {
+            u64 delay = tom_dummy_inflight_frames(true, period, since, 0);
+
+            est = frames_done > delay ? frames_done - delay : 0;
+            KUNIT_EXPECT_GE(test, est, prev);
+            prev = est;
+        }
+    }
+    KUNIT_EXPECT_EQ(test, prev, 3 * period);
+
+    /*
+     * Capture: a writer commits a period, then the reader's tick a guard
+     * later takes it out of the backlog and into frames_done.
+     */
+    frames_done = 0;
+    backlog = 0;
+    prev = 0;
+    for (tick = 0; tick < 4; tick++) {
+        backlog += period;
+        est = frames_done +
+              tom_dummy_inflight_frames(false, period, 0, backlog);
+        KUNIT_EXPECT_GE(test, est, prev);
+        prev = est;
+
+        for (since = 0; since <= period; since += step) {
+            est = frames_done +
+                  tom_dummy_inflight_frames(false, period, since, backlog);
+            KUNIT_EXPECT_GE(test, est, prev);
+            prev = est;
+        }
+
+        frames_done += period;
+        backlog -= period;
+        est = frames_done +
+              tom_dummy_inflight_frames(false, period, 0, backlog);
+        KUNIT_EXPECT_GE(test, est, prev);
+        prev = est;
+    }
+}
+
+static struct kunit_case tom_dummy_test_cases[] = {
+    KUNIT_CASE(tom_dummy_test_sat_add),
+    KUNIT_CASE(tom_dummy_test_mix_tail),
+    KUNIT_CASE(tom_dummy_test_ring_wrap),
+    KUNIT_CASE(tom_dummy_test_levels),
+    KUNIT_CASE(tom_dummy_test_writers),
+    KUNIT_CASE(tom_dummy_test_readers),
+    KUNIT_CASE(tom_dummy_test_lapping),
+    KUNIT_CASE(tom_dummy_test_estimated),
+    {}
+};
+
+static struct kunit_suite tom_dummy_test_suite = {
+    .name = "tom_dummy_loopback",
+    .test_cases = tom_dummy_test_cases,
+};
+
+kunit_test_suite(tom_dummy_test_suite);
+
+MODULE_DESCRIPTION("KUnit tests for the Tom Dummy loopback ring");
+MODULE_AUTHOR("Tom Hsieh");
+MODULE_LICENSE("GPL");
@@ -26,29 +26,86 @@ static const struct snd_soc_ops tom_dummy_machine_ops = {
     .hw_params = tom_dummy_machine_hw_params,
 };
 
-SND_SOC_DAILINK_DEFS(tom_dummy_link,
+#define TOM_DUMMY_FE_DAILINK_DEFS(n)                                \
+    SND_SOC_DAILINK_DEFS(tom_dummy_fe##n,                           \
+        DAILINK_COMP_ARRAY(COMP_CPU(TOM_DUMMY_FE_DAI_NAME(n))),     \
+        DAILINK_COMP_ARRAY(COMP_DUMMY()),                           \
+        DAILINK_COMP_ARRAY(COMP_PLATFORM(TOM_DUMMY_PLATFORM_DRV_NAME)))
+
+TOM_DUMMY_FE_DAILINK_DEFS(0);
+TOM_DUMMY_FE_DAILINK_DEFS(1);
+TOM_DUMMY_FE_DAILINK_DEFS(2);
+TOM_DUMMY_FE_DAILINK_DEFS(3);
+
+SND_SOC_DAILINK_DEFS(tom_dummy_be,
     DAILINK_COMP_ARRAY(COMP_CPU(TOM_DUMMY_CPU_DAI_NAME)),
     DAILINK_COMP_ARRAY(COMP_CODEC(TOM_DUMMY_CODEC_DRV_NAME,
                                   TOM_DUMMY_CODEC_DAI_NAME)),
-    DAILINK_COMP_ARRAY(COMP_PLATFORM(TOM_DUMMY_PLATFORM_DRV_NAME))
+    DAILINK_COMP_ARRAY(COMP_EMPTY())
 );
 
-static struct snd_soc_dai_link tom_dummy_dai_link = {
-    .name          = "Tom Dummy Link",
-    .stream_name   = "Tom Dummy PCM",
+#define TOM_DUMMY_FE_LINK(n)                                        \
+    {                                                               \
+        .name          = "Tom Dummy FE" #n,                         \
+        .stream_name   = "Tom Dummy PCM" #n,                        \
+        .dynamic       = 1,                                         \
+        .dpcm_playback = 1,                                         \
+        .dpcm_capture  = 1,                                         \
+        .trigger       = { SND_SOC_DPCM_TRIGGER_POST,               \
+                           SND_SOC_DPCM_TRIGGER_POST },             \
+        SND_SOC_DAILINK_REG(tom_dummy_fe##n),                       \
+    }
+
+/*
+ * Front-ends 0..N-1 each expose a PCM device; the platform sums all of
+ * their playback streams into the loopback, which the single back-end
+ * (CPU DAI + codec) carries.
+ */
+static struct snd_soc_dai_link tom_dummy_dai_links[] = {
+    TOM_DUMMY_FE_LINK(0),
+    TOM_DUMMY_FE_LINK(1),
+    TOM_DUMMY_FE_LINK(2),
+    TOM_DUMMY_FE_LINK(3),
+    {
+        .name          = "Tom Dummy Link",
+        .stream_name   = "Tom Dummy BE",
+        .no_pcm        = 1,
+        .dpcm_playback = 1,
+        .dpcm_capture  = 1,
+
+        .ops           = &tom_dummy_machine_ops,
+
+        SND_SOC_DAILINK_REG(tom_dummy_be),
+    },
+};
 
-    .ops           = &tom_dummy_machine_ops,
+#define TOM_DUMMY_FE_ROUTES(n)                                      \
+    { TOM_DUMMY_BE_PLAYBACK, NULL, TOM_DUMMY_FE_PLAYBACK(n) },      \
+    { TOM_DUMMY_FE_CAPTURE(n), NULL, TOM_DUMMY_BE_CAPTURE }
 
-    SND_SOC_DAILINK_REG(tom_dummy_link),
+static const struct snd_soc_dapm_route tom_dummy_card_routes[] = {
+    TOM_DUMMY_FE_ROUTES(0),
+    TOM_DUMMY_FE_ROUTES(1),
+    TOM_DUMMY_FE_ROUTES(2),
+    TOM_DUMMY_FE_ROUTES(3),
 };
 
 static struct snd_soc_card tom_dummy_card = {
-    .name      = TOM_DUMMY_CARD_NAME,
-    .owner     = THIS_MODULE,
-    .dai_link  = &tom_dummy_dai_link,
-    .num_links = 1,
+    .name             = TOM_DUMMY_CARD_NAME,
+    .owner            = THIS_MODULE,
+    .dai_link         = tom_dummy_dai_links,
+    .num_links        = ARRAY_SIZE(tom_dummy_dai_links),
+    .dapm_routes      = tom_dummy_card_routes,
+    .num_dapm_routes  = ARRAY_SIZE(tom_dummy_card_routes),
 };
 
+/* Lets in-kernel clients (the stress module) reach the card's PCMs */
+struct snd_soc_card *tom_dummy_machine_get_card(void)
+{
+    return tom_dummy_card.instantiated ? &tom_dummy_card : NULL;
+}
+EXPORT_SYMBOL_GPL(tom_dummy_machine_get_card);
+
 static int tom_dummy_machine_probe(struct platform_device *pdev)
 {
     pr_info("tom_machine: probe\n");
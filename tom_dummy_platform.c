@@ -1,10 +1,18 @@
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/hrtimer.h>
+#include <linux/sched/isolation.h>
+#include <linux/smp.h>
+#include <linux/workqueue.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -18,62 +26,255 @@ struct tom_dummy_runtime {
     struct hrtimer                timer;
     spinlock_t                    lock;
 
+    /* Front-end index and the CPU its timer is pinned to (-1: any) */
+    unsigned int                  fe;
+    int                           timer_cpu;
+    call_single_data_t            arm_csd;
+    ktime_t                       arm_expires;
+    bool                          arm_pending;
+
     snd_pcm_uframes_t             buffer_size;
     snd_pcm_uframes_t             period_size;
     snd_pcm_uframes_t             hw_ptr;
 
     unsigned int                  rate;
     ktime_t                       period_ktime;
+    /* Counted in dev->loopback_rate_users, under dev->loopback_lock */
+    bool                          rate_held;
 
     bool                          running;
+
+    /*
+     * Engine clock, protected by lock: frames_done advances by one period
+     * on every tick, last_tick is the scheduled expiry of that tick.
+     */
+    u64                           frames_done;
+    ktime_t                       last_tick;
+
+    /*
+     * Loopback cursor, protected by dev->loopback_lock. Playback streams
+     * sit on loopback_writers, capture streams on loopback_readers.
+     */
+    struct tom_dummy_cursor       lb;
+    /* Capture backlog in bytes right after the last tick's read */
+    u64                           tick_backlog;
 };
 
 static struct tom_dummy_dev *the_tom_dev;
 
+/* Latency of tom_dummy_timer_sync(), i.e. of cancelling a stream timer */
+static struct {
+    atomic64_t count;
+    atomic64_t total_ns;
+    atomic64_t max_ns;
+} tom_dummy_cancel;
+
+static bool drop_slow_readers;
+module_param(drop_slow_readers, bool, 0644);
+MODULE_PARM_DESC(drop_slow_readers,
+         "Let playback lap capture streams that fall a full ring behind instead of dropping playback periods");
+
+static bool prealloc_pool;
+module_param(prealloc_pool, bool, 0444);
+MODULE_PARM_DESC(prealloc_pool,
+         "Preallocate physically contiguous PCM buffers when the PCMs are created instead of vmalloc per hw_params");
+
+static unsigned int pcm_buffer_kb = 512;
+module_param(pcm_buffer_kb, uint, 0444);
+MODULE_PARM_DESC(pcm_buffer_kb, "PCM buffer size in KiB reserved per substream with prealloc_pool (64..512)");
+
+static unsigned int loopback_kb = LOOPBACK_BUFFER_SIZE / 1024;
+module_param(loopback_kb, uint, 0444);
+MODULE_PARM_DESC(loopback_kb, "Loopback ring size in KiB (64..4096), rounded up to a power of two");
+
+#define TOM_DUMMY_CPU_ANY            (-1)
+#define TOM_DUMMY_CPU_HOUSEKEEPING   (-2)
+
+static int timer_cpus[TOM_DUMMY_NUM_FE] = {
+    [0 ... TOM_DUMMY_NUM_FE - 1] = TOM_DUMMY_CPU_ANY
+};
+/* Load-time only: the ring and the prealloc pool are placed from it once */
+module_param_array(timer_cpus, int, NULL, 0444);
+MODULE_PARM_DESC(timer_cpus,
+         "Per front-end CPU running the stream timer (-1: triggering CPU, -2: a housekeeping CPU)");
+
+static int loopback_node = NUMA_NO_NODE;
+module_param(loopback_node, int, 0444);
+MODULE_PARM_DESC(loopback_node,
+         "NUMA node for the loopback ring (-1: node of timer_cpus[0], else probing node)");
+
+/* Capture lags playback by this much on a shared tick (see first_expiry) */
+#define TOM_DUMMY_LINK_GUARD_NS      (100 * NSEC_PER_USEC)
+
+#define TOM_DUMMY_PCM_BUFFER_MIN     (64 * 1024)
+#define TOM_DUMMY_PCM_BUFFER_MAX     (512 * 1024)
+#define TOM_DUMMY_PERIOD_BYTES_MAX   (64 * 1024)
+
 static const struct snd_pcm_hardware tom_dummy_pcm_hardware = {
     .info = SNDRV_PCM_INFO_MMAP       |
             SNDRV_PCM_INFO_INTERLEAVED |
             SNDRV_PCM_INFO_MMAP_VALID  |
-            SNDRV_PCM_INFO_BATCH,
+            SNDRV_PCM_INFO_BATCH      |
+            SNDRV_PCM_INFO_HAS_LINK_ATIME |
+            SNDRV_PCM_INFO_HAS_LINK_ABSOLUTE_ATIME |
+            SNDRV_PCM_INFO_HAS_LINK_ESTIMATED_ATIME,
     .formats        = SNDRV_PCM_FMTBIT_S16_LE,
     .rates          = SNDRV_PCM_RATE_44100 | SNDRV_PCM_RATE_48000,
     .rate_min       = 44100,
     .rate_max       = 48000,
     .channels_min   = 2,
     .channels_max   = 2,
-    .buffer_bytes_max = 512 * 1024,
+    .buffer_bytes_max = TOM_DUMMY_PCM_BUFFER_MAX,
 
     .period_bytes_min = 4096,
-    .period_bytes_max = 64 * 1024,
+    .period_bytes_max = TOM_DUMMY_PERIOD_BYTES_MAX,
     .periods_min      = 2,
     .periods_max      = 1024,
 };
 
-static void tom_dummy_write_fifo(struct tom_dummy_dev *dev, u8 *src, size_t bytes)
+/*
+ * Caller holds loopback_lock. A new head goes out before the writer
+ * overwrites or marks anything it covers, so a tap reader that re-reads
+ * head after copying sees every overwrite its copy may have raced with.
+ */
+static void tom_dummy_tap_publish_head(struct tom_dummy_dev *dev)
+{
+    WRITE_ONCE(dev->tap->head, dev->loopback_head);
+    smp_wmb();
+}
+
+/* Caller holds loopback_lock; orders ring stores before the counter */
+static void tom_dummy_tap_publish(struct tom_dummy_dev *dev, u64 committed)
+{
+    smp_wmb();
+    WRITE_ONCE(dev->tap->committed, committed);
+}
+
+/*
+ * Caller holds loopback_lock. Meter whatever became a complete mix since
+ * the last call, so the levels always cover every front-end's share of
+ * the same stretch of audio, then publish the counters to the tap.
+ */
+static void tom_dummy_loopback_commit(struct tom_dummy_dev *dev)
+{
+    u64 committed = tom_dummy_loopback_committed(dev);
+    u64 oldest = dev->loopback_head -
+                 min_t(u64, dev->loopback_head, dev->loopback_size);
+    u64 from = max(dev->loopback_metered, oldest);
+
+    if (committed > from) {
+        memset(&dev->levels, 0, sizeof(dev->levels));
+        tom_dummy_ring_levels(dev->loopback_buf, dev->silent,
+                              dev->loopback_size, from, committed - from,
+                              &dev->levels);
+    }
+    dev->loopback_metered = max(dev->loopback_metered, committed);
+
+    tom_dummy_tap_publish(dev, committed);
+}
+
+/* Caller holds loopback_lock */
+static void tom_dummy_lb_attach(struct tom_dummy_dev *dev,
+                                struct tom_dummy_runtime *prtd)
+{
+    bool writer = prtd->substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
+
+    tom_dummy_loopback_join(dev, &prtd->lb, writer);
+}
+
+/* Caller holds loopback_lock */
+static void tom_dummy_lb_detach(struct tom_dummy_dev *dev,
+                                struct tom_dummy_runtime *prtd)
+{
+    if (!tom_dummy_loopback_leave(dev, &prtd->lb))
+        return;
+
+    /* A departing writer can release bytes the others already finished */
+    tom_dummy_loopback_commit(dev);
+
+    /* Nothing is playing any more: do not leave the last level on show */
+    if (list_empty(&dev->loopback_writers))
+        memset(&dev->levels, 0, sizeof(dev->levels));
+}
+
+static bool tom_dummy_write_fifo(struct tom_dummy_dev *dev,
+                                 struct tom_dummy_runtime *prtd,
+                                 u8 *src1, size_t bytes1,
+                                 u8 *src2, size_t bytes2)
+{
+    u64 start, end, fresh;
+    bool silent;
+
+    if (!tom_dummy_loopback_reserve(dev, &prtd->lb, bytes1 + bytes2,
+                                    READ_ONCE(drop_slow_readers), &fresh))
+        return false;
+    tom_dummy_tap_publish_head(dev);
+
+    /* Read back after reserve: a lapped writer is moved to the head */
+    start = prtd->lb.pos;
+    end = start + bytes1 + bytes2;
+
+    /* First writer to reach fresh space marks it silent instead of clearing */
+    if (end > fresh)
+        tom_dummy_ring_mark_silent(dev->silent, dev->loopback_size,
+                                   fresh, end - fresh);
+
+    /* Adding zeros is a no-op: an all-zero period never touches the ring */
+    silent = !memchr_inv(src1, 0, bytes1) &&
+             (!bytes2 || !memchr_inv(src2, 0, bytes2));
+    if (!silent) {
+        tom_dummy_ring_materialize(dev->loopback_buf, dev->silent,
+                                   dev->loopback_size, start, end - start);
+        tom_dummy_ring_mix(dev->loopback_buf, dev->loopback_size,
+                           start, src1, bytes1);
+        if (bytes2)
+            tom_dummy_ring_mix(dev->loopback_buf, dev->loopback_size,
+                               start + bytes1, src2, bytes2);
+    }
+
+    /* Meter what this period completed while it is still hot in cache */
+    prtd->lb.pos = end;
+    tom_dummy_loopback_commit(dev);
+    return true;
+}
+
+/* Non-destructive for other readers: only this reader's cursor moves */
+static bool tom_dummy_read_fifo(struct tom_dummy_dev *dev,
+                                struct tom_dummy_runtime *prtd,
+                                u8 *dst1, size_t bytes1,
+                                u8 *dst2, size_t bytes2)
 {
-    size_t chunk1 = min(bytes, LOOPBACK_BUFFER_SIZE - dev->loopback_wptr);
-    size_t chunk2 = bytes - chunk1;
+    u64 start = prtd->lb.pos;
 
-    memcpy(dev->loopback_buf + dev->loopback_wptr, src, chunk1);
-    if (chunk2)
-        memcpy(dev->loopback_buf, src + chunk1, chunk2);
+    if (!tom_dummy_loopback_readable(dev, &prtd->lb, bytes1 + bytes2))
+        return false;
 
-    dev->loopback_wptr = (dev->loopback_wptr + bytes) % LOOPBACK_BUFFER_SIZE;
-    dev->loopback_filled += bytes;
+    /* Silent chunks are filled with zeros rather than copied */
+    tom_dummy_ring_read(dev->loopback_buf, dev->silent, dev->loopback_size,
+                        start, dst1, bytes1);
+    if (bytes2)
+        tom_dummy_ring_read(dev->loopback_buf, dev->silent,
+                            dev->loopback_size, start + bytes1, dst2, bytes2);
+
+    tom_dummy_loopback_consume(dev, &prtd->lb, bytes1 + bytes2);
+    return true;
 }
 
-static void tom_dummy_read_fifo(struct tom_dummy_dev *dev, u8 *dst, size_t bytes)
+void tom_dummy_platform_get_levels(struct tom_dummy_levels *lv)
 {
-    size_t chunk1 = min(bytes, LOOPBACK_BUFFER_SIZE - dev->loopback_rptr);
-    size_t chunk2 = bytes - chunk1;
+    struct tom_dummy_dev *dev = the_tom_dev;
+    unsigned long flags;
 
-    memcpy(dst, dev->loopback_buf + dev->loopback_rptr, chunk1);
-    if (chunk2)
-        memcpy(dst + chunk1, dev->loopback_buf, chunk2);
+    if (!dev) {
+        memset(lv, 0, sizeof(*lv));
+        return;
+    }
 
-    dev->loopback_rptr = (dev->loopback_rptr + bytes) % LOOPBACK_BUFFER_SIZE;
-    dev->loopback_filled -= bytes;
+    spin_lock_irqsave(&dev->loopback_lock, flags);
+    *lv = dev->levels;
+    spin_unlock_irqrestore(&dev->loopback_lock, flags);
 }
+EXPORT_SYMBOL_GPL(tom_dummy_platform_get_levels);
 
 static enum hrtimer_restart tom_dummy_hrtimer_cb(struct hrtimer *timer)
 {
@@ -111,6 +312,8 @@ static enum hrtimer_restart tom_dummy_hrtimer_cb(struct hrtimer *timer)
     buf_frames = prtd->buffer_size;
 
     prtd->hw_ptr = old_hw_ptr + period;
+    prtd->frames_done += period;
+    prtd->last_tick = hrtimer_get_expires(timer);
     while (prtd->hw_ptr >= buf_frames)
         prtd->hw_ptr -= buf_frames;
 
@@ -135,27 +338,18 @@ static enum hrtimer_restart tom_dummy_hrtimer_cb(struct hrtimer *timer)
         spin_lock_irqsave(&dev->loopback_lock, lb_flags);
 
         if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
-            size_t free_space = LOOPBACK_BUFFER_SIZE - dev->loopback_filled;
-            size_t total_bytes = bytes1 + bytes2;
-
-            if (free_space >= total_bytes) {
-                tom_dummy_write_fifo(dev, dma_ptr1, bytes1);
-                if (bytes2)
-                    tom_dummy_write_fifo(dev, dma_ptr2, bytes2);
-            }
-        } else {
-            size_t total_bytes = bytes1 + bytes2;
-
-            if (dev->loopback_filled >= total_bytes) {
-                tom_dummy_read_fifo(dev, dma_ptr1, bytes1);
-                if (bytes2)
-                    tom_dummy_read_fifo(dev, dma_ptr2, bytes2);
-            } else {
-                memset(dma_ptr1, 0, bytes1);
-                if (bytes2)
-                    memset(dma_ptr2, 0, bytes2);
-            }
+            if (prtd->lb.active)
+                tom_dummy_write_fifo(dev, prtd, dma_ptr1, bytes1,
+                                     dma_ptr2, bytes2);
+        } else if (!prtd->lb.active ||
+                   !tom_dummy_read_fifo(dev, prtd, dma_ptr1, bytes1,
+                                        dma_ptr2, bytes2)) {
+            memset(dma_ptr1, 0, bytes1);
+            if (bytes2)
+                memset(dma_ptr2, 0, bytes2);
         }
+        if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+            prtd->tick_backlog = tom_dummy_loopback_backlog(dev, &prtd->lb);
 
         spin_unlock_irqrestore(&dev->loopback_lock, lb_flags);
     }
@@ -177,15 +371,230 @@ static enum hrtimer_restart tom_dummy_hrtimer_cb(struct hrtimer *timer)
     return HRTIMER_RESTART;
 }
 
+static int tom_dummy_resolve_cpu(unsigned int fe)
+{
+    int cpu = fe < TOM_DUMMY_NUM_FE ? timer_cpus[fe] : TOM_DUMMY_CPU_ANY;
+
+    if (cpu == TOM_DUMMY_CPU_HOUSEKEEPING)
+        return housekeeping_any_cpu(HK_TYPE_TIMER);
+    if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+        return TOM_DUMMY_CPU_ANY;
+
+    return cpu;
+}
+
+static int tom_dummy_resolve_node(unsigned int fe)
+{
+    int cpu = tom_dummy_resolve_cpu(fe);
+
+    return cpu < 0 ? NUMA_NO_NODE : cpu_to_node(cpu);
+}
+
+static void tom_dummy_timer_arm_fn(void *info)
+{
+    struct tom_dummy_runtime *prtd = info;
+
+    hrtimer_start(&prtd->timer, READ_ONCE(prtd->arm_expires),
+                  HRTIMER_MODE_ABS_PINNED);
+    smp_store_release(&prtd->arm_pending, false);
+}
+
+/*
+ * Arm the period timer for an absolute first expiry on the stream's
+ * chosen CPU. trigger() runs with interrupts off, so a remote CPU is
+ * reached through an async IPI that starts the timer pinned there;
+ * restarts from the callback stay put.
+ */
+static void tom_dummy_timer_arm(struct tom_dummy_runtime *prtd, ktime_t expires)
+{
+    WRITE_ONCE(prtd->arm_expires, expires);
+
+    if (prtd->timer_cpu < 0) {
+        hrtimer_start(&prtd->timer, expires, HRTIMER_MODE_ABS);
+        return;
+    }
+
+    /* An IPI still in flight will arm the timer anyway */
+    if (READ_ONCE(prtd->arm_pending))
+        return;
+
+    WRITE_ONCE(prtd->arm_pending, true);
+    if (smp_call_function_single_async(prtd->timer_cpu, &prtd->arm_csd)) {
+        WRITE_ONCE(prtd->arm_pending, false);
+        hrtimer_start(&prtd->timer, expires, HRTIMER_MODE_ABS);
+    }
+}
+
+/*
+ * First expiry for a starting stream. Substreams joined with snd_pcm_link()
+ * are triggered back to back by the core; the first one picks the start
+ * tick and the rest of the group reuse it, so they share one time base.
+ * Since hrtimer_forward() keeps each timer on start + n * period, linked
+ * streams with equal periods stay phase-locked for their whole run.
+ * Capture runs a fixed guard after playback on each tick so it always
+ * finds the period that was just mixed, and trigger() drops any backlog
+ * a linked capture would otherwise read first (audio played while no
+ * capture was attached): loopback latency is then exactly one period
+ * plus the guard, whatever ran before.
+ */
+static ktime_t tom_dummy_first_expiry(struct tom_dummy_runtime *prtd)
+{
+    struct snd_pcm_substream *substream = prtd->substream;
+    struct tom_dummy_dev *dev = prtd->dev;
+    ktime_t now = ktime_get();
+    ktime_t start;
+    unsigned long flags;
+
+    if (!dev || !snd_pcm_stream_linked(substream))
+        return ktime_add(now, prtd->period_ktime);
+
+    spin_lock_irqsave(&dev->loopback_lock, flags);
+    if (dev->link_group != substream->group ||
+        !ktime_after(dev->link_start, now)) {
+        dev->link_group = substream->group;
+        dev->link_start = ktime_add(now, prtd->period_ktime);
+    }
+    start = dev->link_start;
+    spin_unlock_irqrestore(&dev->loopback_lock, flags);
+
+    if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+        start = ktime_add_ns(start, TOM_DUMMY_LINK_GUARD_NS);
+
+    return start;
+}
+
+/* Wait out a pending remote arm, then make sure the timer is dead */
+static void tom_dummy_timer_sync(struct tom_dummy_runtime *prtd)
+{
+    ktime_t t0 = ktime_get();
+    s64 ns, max_ns;
+
+    while (smp_load_acquire(&prtd->arm_pending))
+        cpu_relax();
+
+    hrtimer_cancel(&prtd->timer);
+
+    ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+    atomic64_inc(&tom_dummy_cancel.count);
+    atomic64_add(ns, &tom_dummy_cancel.total_ns);
+    max_ns = atomic64_read(&tom_dummy_cancel.max_ns);
+    while (ns > max_ns &&
+           !atomic64_try_cmpxchg(&tom_dummy_cancel.max_ns, &max_ns, ns))
+        ;
+}
+
+void tom_dummy_platform_get_cancel_stats(struct tom_dummy_cancel_stats *st,
+                                         bool reset)
+{
+    if (reset) {
+        st->count    = atomic64_xchg(&tom_dummy_cancel.count, 0);
+        st->total_ns = atomic64_xchg(&tom_dummy_cancel.total_ns, 0);
+        st->max_ns   = atomic64_xchg(&tom_dummy_cancel.max_ns, 0);
+    } else {
+        st->count    = atomic64_read(&tom_dummy_cancel.count);
+        st->total_ns = atomic64_read(&tom_dummy_cancel.total_ns);
+        st->max_ns   = atomic64_read(&tom_dummy_cancel.max_ns);
+    }
+}
+EXPORT_SYMBOL_GPL(tom_dummy_platform_get_cancel_stats);
+
+/*
+ * Every stream on the loopback shares one rate, the way streams sharing a
+ * DPCM back-end do: the ring is summed byte for byte. Caller holds
+ * loopback_lock; returns 0 while no other stream has fixed the rate.
+ */
+static unsigned int tom_dummy_loopback_rate(struct tom_dummy_dev *dev,
+                                            struct tom_dummy_runtime *prtd)
+{
+    if (dev->loopback_rate_users > (prtd->rate_held ? 1 : 0))
+        return dev->loopback_rate;
+
+    return 0;
+}
+
+static int tom_dummy_rate_rule(struct snd_pcm_hw_params *params,
+                               struct snd_pcm_hw_rule *rule)
+{
+    struct tom_dummy_runtime *prtd = rule->private;
+    struct snd_interval fixed = { .integer = 1 };
+    unsigned long flags;
+    unsigned int rate;
+
+    if (!prtd->dev)
+        return 0;
+
+    spin_lock_irqsave(&prtd->dev->loopback_lock, flags);
+    rate = tom_dummy_loopback_rate(prtd->dev, prtd);
+    spin_unlock_irqrestore(&prtd->dev->loopback_lock, flags);
+
+    if (!rate)
+        return 0;
+
+    fixed.min = rate;
+    fixed.max = rate;
+    return snd_interval_refine(hw_param_interval(params, rule->var), &fixed);
+}
+
+/* The rule narrows refine; this catches two hw_params racing past it */
+static int tom_dummy_rate_get(struct tom_dummy_runtime *prtd,
+                              unsigned int rate)
+{
+    struct tom_dummy_dev *dev = prtd->dev;
+    unsigned long flags;
+    unsigned int cur;
+
+    if (!dev)
+        return 0;
+
+    spin_lock_irqsave(&dev->loopback_lock, flags);
+    cur = tom_dummy_loopback_rate(dev, prtd);
+    if (cur && cur != rate) {
+        spin_unlock_irqrestore(&dev->loopback_lock, flags);
+        pr_err("tom_platform: loopback runs at %u Hz, refusing %u Hz\n",
+               cur, rate);
+        return -EBUSY;
+    }
+
+    if (!prtd->rate_held) {
+        dev->loopback_rate_users++;
+        prtd->rate_held = true;
+    }
+    dev->loopback_rate = rate;
+    spin_unlock_irqrestore(&dev->loopback_lock, flags);
+
+    return 0;
+}
+
+static void tom_dummy_rate_put(struct tom_dummy_runtime *prtd)
+{
+    struct tom_dummy_dev *dev = prtd->dev;
+    unsigned long flags;
+
+    if (!dev)
+        return;
+
+    spin_lock_irqsave(&dev->loopback_lock, flags);
+    if (prtd->rate_held) {
+        prtd->rate_held = false;
+        if (!--dev->loopback_rate_users)
+            dev->loopback_rate = 0;
+    }
+    spin_unlock_irqrestore(&dev->loopback_lock, flags);
+}
+
 static int tom_dummy_platform_open(struct snd_soc_component *component,
                    struct snd_pcm_substream *substream)
 {
     struct snd_pcm_runtime *runtime = substream->runtime;
+    struct snd_soc_pcm_runtime *rtd = snd_soc_substream_to_rtd(substream);
+    unsigned int fe = snd_soc_rtd_to_cpu(rtd, 0)->id;
     struct tom_dummy_runtime *prtd;
+    int ret;
 
     pr_info("tom_platform: open (stream=%d)\n", substream->stream);
 
-    prtd = kzalloc(sizeof(*prtd), GFP_KERNEL);
+    /* Keep the hot per-stream state on the node that runs its timer */
+    prtd = kzalloc_node(sizeof(*prtd), GFP_KERNEL, tom_dummy_resolve_node(fe));
     if (!prtd)
         return -ENOMEM;
 
@@ -195,13 +604,29 @@ static int tom_dummy_platform_open(struct snd_soc_component *component,
     prtd->substream = substream;
     prtd->running    = false;
     prtd->hw_ptr     = 0;
+    prtd->fe         = fe;
+    prtd->timer_cpu  = TOM_DUMMY_CPU_ANY;
 
     spin_lock_init(&prtd->lock);
+    INIT_LIST_HEAD(&prtd->lb.node);
+    INIT_CSD(&prtd->arm_csd, tom_dummy_timer_arm_fn, prtd);
 
     hrtimer_init(&prtd->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
     prtd->timer.function = tom_dummy_hrtimer_cb;
 
     runtime->hw = tom_dummy_pcm_hardware;
+    /* Without a preallocated buffer the managed path still allocates */
+    if (prealloc_pool && substream->dma_buffer.bytes)
+        runtime->hw.buffer_bytes_max = substream->dma_buffer.bytes;
+
+    ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_RATE,
+                              tom_dummy_rate_rule, prtd,
+                              SNDRV_PCM_HW_PARAM_RATE, -1);
+    if (ret < 0) {
+        runtime->private_data = NULL;
+        kfree(prtd);
+        return ret;
+    }
 
     return 0;
 }
@@ -216,13 +641,24 @@ static int tom_dummy_platform_close(struct snd_soc_component *component,
     pr_info("tom_platform: close (stream=%d)\n", substream->stream);
 
     if (prtd) {
-        hrtimer_cancel(&prtd->timer);
+        tom_dummy_timer_sync(prtd);
 
         spin_lock_irqsave(&prtd->lock, flags);
         prtd->running    = false;
         prtd->substream = NULL;
         spin_unlock_irqrestore(&prtd->lock, flags);
 
+        if (prtd->dev) {
+            spin_lock_irqsave(&prtd->dev->loopback_lock, flags);
+            tom_dummy_lb_detach(prtd->dev, prtd);
+            spin_unlock_irqrestore(&prtd->dev->loopback_lock, flags);
+        }
+        tom_dummy_rate_put(prtd);
+
+        if (prtd->lb.underruns || prtd->lb.overruns)
+            pr_info("tom_platform: stream=%d loopback underruns=%lu overruns=%lu\n",
+                substream->stream, prtd->lb.underruns, prtd->lb.overruns);
+
         runtime->private_data = NULL;
         kfree(prtd);
     }
@@ -240,10 +676,15 @@ static int tom_dummy_platform_hw_params(struct snd_soc_component *component,
     snd_pcm_uframes_t buffer_size = params_buffer_size(params);
     snd_pcm_uframes_t period_size = params_period_size(params);
     u64 nsecs;
+    int ret;
 
     pr_info("tom_platform: hw_params buffer=%u period=%u rate=%u\n",
         params_buffer_bytes(params), params_period_bytes(params), rate);
 
+    ret = tom_dummy_rate_get(prtd, rate);
+    if (ret)
+        return ret;
+
     prtd->buffer_size = buffer_size;
     prtd->period_size = period_size;
     prtd->rate        = rate;
@@ -253,8 +694,11 @@ static int tom_dummy_platform_hw_params(struct snd_soc_component *component,
     do_div(nsecs, rate);
     prtd->period_ktime = ns_to_ktime(nsecs);
 
-    pr_info("tom_platform: period_ktime=%llu ns\n",
-        (unsigned long long)nsecs);
+    /* Resolved here, in process context, so trigger() only reads it */
+    prtd->timer_cpu = tom_dummy_resolve_cpu(prtd->fe);
+
+    pr_info("tom_platform: period_ktime=%llu ns timer_cpu=%d\n",
+        (unsigned long long)nsecs, prtd->timer_cpu);
 
     return 0;
 }
@@ -273,7 +717,14 @@ static int tom_dummy_platform_hw_free(struct snd_soc_component *component,
         prtd->running = false;
         spin_unlock_irqrestore(&prtd->lock, flags);
 
-        hrtimer_cancel(&prtd->timer);
+        tom_dummy_timer_sync(prtd);
+
+        if (prtd->dev) {
+            spin_lock_irqsave(&prtd->dev->loopback_lock, flags);
+            tom_dummy_lb_detach(prtd->dev, prtd);
+            spin_unlock_irqrestore(&prtd->dev->loopback_lock, flags);
+        }
+        tom_dummy_rate_put(prtd);
     }
 
     return 0;
@@ -293,20 +744,37 @@ static int tom_dummy_platform_trigger(struct snd_soc_component *component,
     struct snd_pcm_runtime *runtime = substream->runtime;
     struct tom_dummy_runtime *prtd = runtime->private_data;
     unsigned long flags;
+    ktime_t expires;
 
     switch (cmd) {
     case SNDRV_PCM_TRIGGER_START:
     case SNDRV_PCM_TRIGGER_RESUME:
     case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+        expires = tom_dummy_first_expiry(prtd);
+
         spin_lock_irqsave(&prtd->lock, flags);
-        if (cmd == SNDRV_PCM_TRIGGER_START)
+        if (cmd == SNDRV_PCM_TRIGGER_START) {
             prtd->hw_ptr = 0;
+            prtd->frames_done = 0;
+        }
+        prtd->last_tick = ktime_sub(expires, prtd->period_ktime);
         prtd->running = true;
         spin_unlock_irqrestore(&prtd->lock, flags);
 
-        hrtimer_start(&prtd->timer,
-                  prtd->period_ktime,
-                  HRTIMER_MODE_REL);
+        if (prtd->dev) {
+            spin_lock_irqsave(&prtd->dev->loopback_lock, flags);
+            tom_dummy_lb_attach(prtd->dev, prtd);
+            /* A linked capture must not start on audio played before it */
+            if (cmd == SNDRV_PCM_TRIGGER_START &&
+                substream->stream == SNDRV_PCM_STREAM_CAPTURE &&
+                snd_pcm_stream_linked(substream))
+                tom_dummy_loopback_skip_backlog(prtd->dev, &prtd->lb);
+            prtd->tick_backlog = tom_dummy_loopback_backlog(prtd->dev,
+                                                            &prtd->lb);
+            spin_unlock_irqrestore(&prtd->dev->loopback_lock, flags);
+        }
+
+        tom_dummy_timer_arm(prtd, expires);
         break;
 
     case SNDRV_PCM_TRIGGER_STOP:
@@ -315,6 +783,13 @@ static int tom_dummy_platform_trigger(struct snd_soc_component *component,
         spin_lock_irqsave(&prtd->lock, flags);
         prtd->running = false;
         spin_unlock_irqrestore(&prtd->lock, flags);
+
+        /* A stopped stream must not hold back the other side */
+        if (prtd->dev) {
+            spin_lock_irqsave(&prtd->dev->loopback_lock, flags);
+            tom_dummy_lb_detach(prtd->dev, prtd);
+            spin_unlock_irqrestore(&prtd->dev->loopback_lock, flags);
+        }
         break;
 
     default:
@@ -343,18 +818,205 @@ tom_dummy_platform_pointer(struct snd_soc_component *component,
     return ptr;
 }
 
+/* Frames of the current period that have elapsed at the link by "now" */
+static snd_pcm_uframes_t tom_dummy_since_tick(struct tom_dummy_runtime *prtd,
+                                              ktime_t now)
+{
+    u64 ns;
+
+    if (!prtd->running || !ktime_after(now, prtd->last_tick))
+        return 0;
+
+    ns = min_t(u64, ktime_to_ns(ktime_sub(now, prtd->last_tick)),
+               ktime_to_ns(prtd->period_ktime));
+    return min_t(snd_pcm_uframes_t,
+                 mul_u64_u32_div(ns, prtd->rate, NSEC_PER_SEC),
+                 prtd->period_size);
+}
+
+/*
+ * Frames in flight (see tom_dummy_inflight_frames()), "since" frames into
+ * the current period. at_tick selects the capture backlog as it was right
+ * after the last tick rather than now, for positions taken at that tick.
+ */
+static snd_pcm_sframes_t tom_dummy_inflight(struct snd_pcm_substream *substream,
+                                            struct tom_dummy_runtime *prtd,
+                                            snd_pcm_uframes_t since,
+                                            bool running, bool at_tick)
+{
+    bool playback = substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
+    struct tom_dummy_dev *dev = prtd->dev;
+    u64 backlog = 0;
+    unsigned long flags;
+
+    if (!running)
+        return 0;
+
+    if (!playback && dev) {
+        spin_lock_irqsave(&dev->loopback_lock, flags);
+        backlog = at_tick ? prtd->tick_backlog :
+                            tom_dummy_loopback_backlog(dev, &prtd->lb);
+        spin_unlock_irqrestore(&dev->loopback_lock, flags);
+    }
+
+    return tom_dummy_inflight_frames(playback, prtd->period_size, since,
+                                     bytes_to_frames(substream->runtime,
+                                                     backlog));
+}
+
+/* Picked up by the core after every pointer() call as runtime->delay */
+static snd_pcm_sframes_t
+tom_dummy_platform_delay(struct snd_soc_component *component,
+                         struct snd_pcm_substream *substream)
+{
+    struct tom_dummy_runtime *prtd = substream->runtime->private_data;
+    snd_pcm_uframes_t since;
+    unsigned long flags;
+    bool running;
+
+    if (!prtd || !prtd->rate)
+        return 0;
+
+    spin_lock_irqsave(&prtd->lock, flags);
+    since = tom_dummy_since_tick(prtd, ktime_get());
+    running = prtd->running;
+    spin_unlock_irqrestore(&prtd->lock, flags);
+
+    return tom_dummy_inflight(substream, prtd, since, running, false);
+}
+
+/*
+ * Audio timestamps come straight from the engine clock, which is the
+ * CLOCK_MONOTONIC hrtimer itself:
+ *  - LINK:           position at the last tick, paired with that tick's
+ *                    scheduled expiry (exact, no interpolation).
+ *  - LINK_ABSOLUTE:  position interpolated to "now" within the current
+ *                    period, paired with "now".
+ *  - LINK_ESTIMATED: the position at the last tick with the in-flight
+ *                    frames at "now" folded in, i.e. an estimate of the
+ *                    audio time at the far side of the loopback.
+ * With report_delay set, every type is delayed like LINK_ESTIMATED, the
+ * way the core applies runtime->delay to hw_ptr. The delay already covers
+ * the partial period, so it is applied to the tick-aligned position and
+ * measured at the same instant the system timestamp stands for.
+ */
+static int tom_dummy_platform_get_time_info(struct snd_soc_component *component,
+                        struct snd_pcm_substream *substream,
+                        struct timespec64 *system_ts,
+                        struct timespec64 *audio_ts,
+                        struct snd_pcm_audio_tstamp_config *audio_tstamp_config,
+                        struct snd_pcm_audio_tstamp_report *audio_tstamp_report)
+{
+    struct snd_pcm_runtime *runtime = substream->runtime;
+    struct tom_dummy_runtime *prtd = runtime->private_data;
+    unsigned int type = audio_tstamp_config->type_requested;
+    ktime_t now = ktime_get();
+    ktime_t sys;
+    struct timespec64 other;
+    s64 frames;
+    snd_pcm_sframes_t delay;
+    snd_pcm_uframes_t since;
+    unsigned long flags;
+    bool running;
+
+    if (!prtd || !prtd->rate ||
+        (type != SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK &&
+         type != SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ABSOLUTE &&
+         type != SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ESTIMATED)) {
+        audio_tstamp_report->actual_type = SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+        return 0;
+    }
+
+    spin_lock_irqsave(&prtd->lock, flags);
+    frames = prtd->frames_done;
+    sys = prtd->last_tick;
+    since = 0;
+    if (type != SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK) {
+        since = tom_dummy_since_tick(prtd, now);
+        sys = now;
+    }
+    running = prtd->running;
+    spin_unlock_irqrestore(&prtd->lock, flags);
+
+    if (audio_tstamp_config->report_delay ||
+        type == SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ESTIMATED) {
+        delay = tom_dummy_inflight(substream, prtd, since, running,
+                                   type == SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK);
+        if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+            frames = max_t(s64, frames - delay, 0);
+        else
+            frames += delay;
+    } else {
+        frames += since;
+    }
+
+    if (runtime->tstamp_type == SNDRV_PCM_TSTAMP_TYPE_MONOTONIC) {
+        *system_ts = ktime_to_timespec64(sys);
+    } else {
+        /* Other clocks: back-date their "now" by the same offset */
+        snd_pcm_gettime(runtime, &other);
+        *system_ts = ktime_to_timespec64(ktime_sub(timespec64_to_ktime(other),
+                                                   ktime_sub(now, sys)));
+    }
+
+    /* 64x32 multiply-divide: frames * NSEC_PER_SEC would overflow in days */
+    *audio_ts = ns_to_timespec64(mul_u64_u32_div(frames, NSEC_PER_SEC,
+                                                 prtd->rate));
+
+    audio_tstamp_report->actual_type = type;
+    audio_tstamp_report->accuracy_report = 1;
+    audio_tstamp_report->accuracy = hrtimer_resolution;
+
+    return 0;
+}
+
+static long tom_dummy_prealloc_pool(void *arg)
+{
+    struct snd_pcm *pcm = arg;
+    size_t pool_bytes;
+
+    /*
+     * Reserve the whole buffer up front as physically contiguous pages.
+     * With size == max the managed hw_params path reuses it and never
+     * allocates while streams are being set up.
+     */
+    pool_bytes = clamp_t(size_t, (size_t)pcm_buffer_kb * 1024,
+                 TOM_DUMMY_PCM_BUFFER_MIN, TOM_DUMMY_PCM_BUFFER_MAX);
+
+    return snd_pcm_set_managed_buffer_all(pcm,
+                          SNDRV_DMA_TYPE_CONTINUOUS,
+                          NULL,
+                          pool_bytes,
+                          pool_bytes);
+}
+
 static int tom_dummy_platform_pcm_construct(struct snd_soc_component *component,
                         struct snd_soc_pcm_runtime *rtd)
 {
+    int cpu;
     int ret;
 
     pr_info("tom_platform: pcm_construct (pcm=%s)\n", rtd->pcm->name);
 
-    ret = snd_pcm_set_managed_buffer_all(rtd->pcm,
-                         SNDRV_DMA_TYPE_VMALLOC,
-                         NULL,
-                         64 * 1024,
-                         512 * 1024);
+    if (!prealloc_pool) {
+        ret = snd_pcm_set_managed_buffer_all(rtd->pcm,
+                             SNDRV_DMA_TYPE_VMALLOC,
+                             NULL,
+                             TOM_DUMMY_PCM_BUFFER_MIN,
+                             TOM_DUMMY_PCM_BUFFER_MAX);
+        goto out;
+    }
+
+    /*
+     * Page allocations prefer the node of the CPU doing them, so reserve
+     * the pool from the CPU that will run this front-end's timer.
+     */
+    cpu = tom_dummy_resolve_cpu(snd_soc_rtd_to_cpu(rtd, 0)->id);
+    if (cpu >= 0)
+        ret = work_on_cpu(cpu, tom_dummy_prealloc_pool, rtd->pcm);
+    else
+        ret = tom_dummy_prealloc_pool(rtd->pcm);
+out:
     if (ret < 0)
         dev_err(component->dev,
             "tom_platform: set_managed_buffer_all failed: %d\n",
@@ -363,6 +1025,36 @@ static int tom_dummy_platform_pcm_construct(struct snd_soc_component *component,
     return ret;
 }
 
+#define TOM_DUMMY_FE_DAI(n)                                         \
+    {                                                               \
+        .name = TOM_DUMMY_FE_DAI_NAME(n),                           \
+        .id   = n,                                                  \
+        .playback = {                                               \
+            .stream_name  = TOM_DUMMY_FE_PLAYBACK(n),               \
+            .channels_min = 2,                                      \
+            .channels_max = 2,                                      \
+            .rates        = SNDRV_PCM_RATE_44100 |                  \
+                            SNDRV_PCM_RATE_48000,                   \
+            .formats      = SNDRV_PCM_FMTBIT_S16_LE,                \
+        },                                                          \
+        .capture = {                                                \
+            .stream_name  = TOM_DUMMY_FE_CAPTURE(n),                \
+            .channels_min = 2,                                      \
+            .channels_max = 2,                                      \
+            .rates        = SNDRV_PCM_RATE_44100 |                  \
+                            SNDRV_PCM_RATE_48000,                   \
+            .formats      = SNDRV_PCM_FMTBIT_S16_LE,                \
+        },                                                          \
+    }
+
+/* DPCM front-end DAIs, one PCM device each, all mixed into the loopback */
+static struct snd_soc_dai_driver tom_dummy_fe_dais[TOM_DUMMY_NUM_FE] = {
+    TOM_DUMMY_FE_DAI(0),
+    TOM_DUMMY_FE_DAI(1),
+    TOM_DUMMY_FE_DAI(2),
+    TOM_DUMMY_FE_DAI(3),
+};
+
 static const struct snd_soc_component_driver tom_dummy_platform_component = {
     .name          = TOM_DUMMY_PLATFORM_DRV_NAME,
     .pcm_construct = tom_dummy_platform_pcm_construct,
@@ -374,31 +1066,178 @@ static const struct snd_soc_component_driver tom_dummy_platform_component = {
     .prepare   = tom_dummy_platform_prepare,
     .trigger   = tom_dummy_platform_trigger,
     .pointer   = tom_dummy_platform_pointer,
+    .delay     = tom_dummy_platform_delay,
+    .get_time_info = tom_dummy_platform_get_time_info,
 };
 
+static int tom_dummy_tap_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct dentry *dentry = file->f_path.dentry;
+    struct tom_dummy_dev *dev = file->private_data;
+    unsigned long i;
+    struct page *page;
+    int ret;
+
+    /* Fails once the tap is being removed; dev stays valid until the put */
+    ret = debugfs_file_get(dentry);
+    if (ret)
+        return ret;
+
+    if (vma->vm_pgoff ||
+        vma->vm_end - vma->vm_start > PAGE_SIZE + dev->loopback_size) {
+        ret = -EINVAL;
+        goto out;
+    }
+    if (vma->vm_flags & VM_WRITE) {
+        ret = -EPERM;
+        goto out;
+    }
+
+    vm_flags_mod(vma, VM_DONTEXPAND | VM_DONTDUMP, VM_MAYWRITE);
+
+    /*
+     * vm_insert_page() takes a reference on every page it maps, so the
+     * header and ring stay allocated for as long as an analyzer has them
+     * mapped, even across an unbind of the device.
+     */
+    for (i = 0; i < vma_pages(vma); i++) {
+        page = i ? virt_to_page(dev->loopback_buf + (i - 1) * PAGE_SIZE) :
+                   virt_to_page(dev->tap);
+        ret = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE, page);
+        if (ret)
+            break;
+    }
+out:
+    debugfs_file_put(dentry);
+    return ret;
+}
+
+static const struct file_operations tom_dummy_tap_fops = {
+    .owner = THIS_MODULE,
+    .open  = simple_open,
+    .mmap  = tom_dummy_tap_mmap,
+};
+
+static int tom_dummy_timer_cancel_show(struct seq_file *m, void *unused)
+{
+    struct tom_dummy_cancel_stats st;
+
+    tom_dummy_platform_get_cancel_stats(&st, false);
+    seq_printf(m, "count: %llu\navg_ns: %llu\nmax_ns: %llu\n",
+               st.count, st.count ? div64_u64(st.total_ns, st.count) : 0,
+               st.max_ns);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tom_dummy_timer_cancel);
+
+static void tom_dummy_debugfs_remove(void *data)
+{
+    debugfs_remove_recursive(data);
+}
+
+static int tom_dummy_debugfs_init(struct platform_device *pdev,
+                                  struct tom_dummy_dev *dev)
+{
+    struct dentry *dir;
+
+    dir = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+    /*
+     * The full proxy of debugfs_create_file() does not forward mmap, so
+     * the tap takes the unsafe variant and guards itself with
+     * debugfs_file_get()/put().
+     */
+    debugfs_create_file_unsafe("loopback_tap", 0444, dir, dev,
+                               &tom_dummy_tap_fops);
+    debugfs_create_file("timer_cancel", 0444, dir, NULL,
+                        &tom_dummy_timer_cancel_fops);
+
+    return devm_add_action_or_reset(&pdev->dev, tom_dummy_debugfs_remove, dir);
+}
+
+/* Pages still mapped through the tap are only freed at their munmap */
+static void tom_dummy_free_ring(void *data)
+{
+    struct tom_dummy_dev *dev = data;
+    struct page *page = virt_to_page(dev->loopback_buf);
+    unsigned long i;
+
+    for (i = 0; i < dev->loopback_size >> PAGE_SHIFT; i++)
+        __free_page(page + i);
+}
+
 static int tom_dummy_platform_probe(struct platform_device *pdev)
 {
     struct tom_dummy_dev *dev;
+    struct page *ring;
+    int node;
+    int ret;
 
     dev = devm_kzalloc(&pdev->dev, sizeof(*dev), GFP_KERNEL);
     if (!dev)
         return -ENOMEM;
 
-    dev->loopback_buf = devm_kzalloc(&pdev->dev,
-                     LOOPBACK_BUFFER_SIZE,
-                     GFP_KERNEL);
-    if (!dev->loopback_buf)
+    /*
+     * The ring is reserved once here as whole, physically contiguous
+     * pages so the tap can map it straight into userspace. It must hold
+     * at least one full period, or a writer would mix past its end.
+     */
+    dev->loopback_size = roundup_pow_of_two(clamp_t(size_t,
+                            (size_t)loopback_kb * 1024,
+                            max_t(size_t, PAGE_SIZE,
+                                  TOM_DUMMY_PERIOD_BYTES_MAX),
+                            LOOPBACK_BUFFER_SIZE_MAX));
+    node = loopback_node;
+    if (node == NUMA_NO_NODE)
+        node = tom_dummy_resolve_node(0);
+    if (node != NUMA_NO_NODE && !node_online(node))
+        node = NUMA_NO_NODE;
+
+    ring = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO,
+                get_order(dev->loopback_size));
+    if (!ring)
+        return -ENOMEM;
+
+    /* Refcount every page on its own so the tap can map them one by one */
+    split_page(ring, get_order(dev->loopback_size));
+
+    dev->loopback_buf = page_address(ring);
+    ret = devm_add_action_or_reset(&pdev->dev, tom_dummy_free_ring, dev);
+    if (ret)
+        return ret;
+
+    dev->tap = (struct tom_dummy_tap_hdr *)devm_get_free_pages(&pdev->dev,
+                     GFP_KERNEL | __GFP_ZERO, 0);
+    if (!dev->tap)
         return -ENOMEM;
 
+    dev->tap->version    = TOM_DUMMY_TAP_VERSION;
+    dev->tap->ring_size  = dev->loopback_size;
+    dev->tap->chunk_size = TOM_DUMMY_SILENCE_CHUNK;
+
+    /* The silence bitmap lives in the tap page so analyzers can see it */
+    BUILD_BUG_ON(sizeof(struct tom_dummy_tap_hdr) +
+                 BITS_TO_LONGS(LOOPBACK_BUFFER_SIZE_MAX /
+                               TOM_DUMMY_SILENCE_CHUNK) * sizeof(long) >
+                 PAGE_SIZE);
+    dev->silent = (unsigned long *)dev->tap->silent;
+
     spin_lock_init(&dev->loopback_lock);
+    INIT_LIST_HEAD(&dev->loopback_writers);
+    INIT_LIST_HEAD(&dev->loopback_readers);
+
+    ret = tom_dummy_debugfs_init(pdev, dev);
+    if (ret)
+        return ret;
 
     the_tom_dev = dev;
 
-    pr_info("tom_platform: probe done, loopback buffer ready\n");
+    pr_info("tom_platform: probe done, loopback buffer ready (%zu bytes, node %d)\n",
+        dev->loopback_size, page_to_nid(ring));
 
     return devm_snd_soc_register_component(&pdev->dev,
                            &tom_dummy_platform_component,
-                           NULL, 0);
+                           tom_dummy_fe_dais,
+                           ARRAY_SIZE(tom_dummy_fe_dais));
 }
 
 static struct platform_driver tom_dummy_platform_driver = {
@@ -0,0 +1,319 @@
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/debug_locks.h>
+#include <linux/delay.h>
+#include <linux/fcntl.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <sound/core.h>
+#include <sound/pcm.h>
+#include <sound/pcm_params.h>
+#include <sound/soc.h>
+
+#include "tom_dummy.h"
+
+/*
+ * In-kernel stress for the platform PCM engine. Worker threads, bound
+ * round-robin to the online CPUs, open the card's front-end PCM device
+ * nodes and run hw_params/sw_params/prepare/start, let the hrtimer tick,
+ * then tear the stream down again. Going through the device node gives
+ * the same open/release path as userspace, including the core's open
+ * locking. Runs once at module load and prints a report.
+ */
+
+static unsigned int threads;
+module_param(threads, uint, 0444);
+MODULE_PARM_DESC(threads, "Concurrent workers (default: one per online CPU)");
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Open/start/close cycles per worker");
+
+static unsigned int dwell_us = 200;
+module_param(dwell_us, uint, 0444);
+MODULE_PARM_DESC(dwell_us, "Time a stream runs before it is torn down");
+
+#define TOM_STRESS_MAX_PCMS    (TOM_DUMMY_NUM_FE)
+#define TOM_STRESS_PERIOD      4096
+#define TOM_STRESS_BUFFER      (4 * TOM_STRESS_PERIOD)
+
+struct tom_stress_stats {
+    atomic64_t cycles;
+    atomic64_t busy;
+    atomic64_t errors;
+    atomic64_t teardown_ns;
+    atomic64_t teardown_max_ns;
+};
+
+struct tom_stress_worker {
+    struct task_struct *task;
+    unsigned int id;
+    struct completion done;
+};
+
+static struct snd_pcm *tom_stress_pcms[TOM_STRESS_MAX_PCMS];
+static unsigned int tom_stress_num_pcms;
+static struct tom_stress_stats tom_stress_stats;
+
+static void tom_stress_pin(struct snd_pcm_hw_params *params,
+                           snd_pcm_hw_param_t var, unsigned int val)
+{
+    struct snd_interval *i = hw_param_interval(params, var);
+
+    i->min = val;
+    i->max = val;
+    i->openmin = 0;
+    i->openmax = 0;
+    i->integer = 1;
+    i->empty = 0;
+}
+
+static int tom_stress_setup(struct snd_pcm_substream *substream)
+{
+    struct snd_pcm_hw_params *params;
+    struct snd_pcm_sw_params sw = {};
+    struct snd_pcm_runtime *runtime = substream->runtime;
+    struct snd_mask *mask;
+    int ret;
+
+    params = kmalloc(sizeof(*params), GFP_KERNEL);
+    if (!params)
+        return -ENOMEM;
+
+    _snd_pcm_hw_params_any(params);
+
+    mask = hw_param_mask(params, SNDRV_PCM_HW_PARAM_ACCESS);
+    snd_mask_none(mask);
+    snd_mask_set(mask, (__force unsigned int)SNDRV_PCM_ACCESS_RW_INTERLEAVED);
+
+    mask = hw_param_mask(params, SNDRV_PCM_HW_PARAM_FORMAT);
+    snd_mask_none(mask);
+    snd_mask_set_format(mask, SNDRV_PCM_FORMAT_S16_LE);
+
+    tom_stress_pin(params, SNDRV_PCM_HW_PARAM_CHANNELS, 2);
+    tom_stress_pin(params, SNDRV_PCM_HW_PARAM_RATE, 48000);
+    tom_stress_pin(params, SNDRV_PCM_HW_PARAM_PERIOD_BYTES, TOM_STRESS_PERIOD);
+    tom_stress_pin(params, SNDRV_PCM_HW_PARAM_BUFFER_BYTES, TOM_STRESS_BUFFER);
+
+    ret = snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_HW_PARAMS, params);
+    kfree(params);
+    if (ret < 0)
+        return ret;
+
+    /* Free-run playback on silence instead of stopping on empty buffer */
+    sw.tstamp_mode     = SNDRV_PCM_TSTAMP_NONE;
+    sw.period_step     = 1;
+    sw.avail_min       = runtime->period_size;
+    sw.start_threshold = 1;
+    sw.stop_threshold  = runtime->boundary;
+    sw.boundary        = runtime->boundary;
+
+    ret = snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_SW_PARAMS, &sw);
+    if (ret < 0)
+        return ret;
+
+    ret = snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_PREPARE, NULL);
+    if (ret < 0)
+        return ret;
+
+    return snd_pcm_kernel_ioctl(substream, SNDRV_PCM_IOCTL_START, NULL);
+}
+
+/* Device node of one direction of a front-end, e.g. /dev/snd/pcmC2D0p */
+static struct file *tom_stress_open(struct snd_pcm *pcm, int stream)
+{
+    char path[32];
+
+    snprintf(path, sizeof(path), "/dev/snd/pcmC%dD%d%c",
+             pcm->card->number, pcm->device,
+             stream == SNDRV_PCM_STREAM_PLAYBACK ? 'p' : 'c');
+
+    /* Non-blocking: a busy front-end fails with -EBUSY instead of waiting */
+    return filp_open(path, O_RDWR | O_NONBLOCK, 0);
+}
+
+static void tom_stress_cycle(unsigned int id, unsigned int iter)
+{
+    struct tom_stress_stats *st = &tom_stress_stats;
+    struct snd_pcm *pcm = tom_stress_pcms[(id + iter) % tom_stress_num_pcms];
+    int stream = (id + iter / tom_stress_num_pcms) & 1;
+    struct snd_pcm_file *pcm_file;
+    struct file *file;
+    ktime_t t0;
+    s64 ns, max_ns;
+    int ret;
+
+    file = tom_stress_open(pcm, stream);
+    if (IS_ERR(file)) {
+        ret = PTR_ERR(file);
+        if (ret == -EBUSY || ret == -EAGAIN) {
+            atomic64_inc(&st->busy);
+        } else {
+            pr_warn_ratelimited("tom_stress: open failed: %d\n", ret);
+            atomic64_inc(&st->errors);
+        }
+        return;
+    }
+
+    pcm_file = file->private_data;
+    ret = tom_stress_setup(pcm_file->substream);
+    if (ret < 0) {
+        pr_warn_ratelimited("tom_stress: setup failed: %d\n", ret);
+        atomic64_inc(&st->errors);
+    } else {
+        usleep_range(dwell_us, dwell_us + dwell_us / 4 + 1);
+    }
+
+    /*
+     * Release drops the stream and tears down the DPCM back-end, DAPM and
+     * the platform, whose hw_free and close cancel the hrtimer; the
+     * platform times that cancel itself. A kernel thread's fput() is
+     * deferred to a workqueue, so release synchronously to time the whole
+     * teardown and to free the front-end for the next cycle.
+     */
+    t0 = ktime_get();
+    __fput_sync(file);
+    ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+
+    atomic64_add(ns, &st->teardown_ns);
+    max_ns = atomic64_read(&st->teardown_max_ns);
+    while (ns > max_ns &&
+           !atomic64_try_cmpxchg(&st->teardown_max_ns, &max_ns, ns))
+        ;
+
+    if (ret >= 0)
+        atomic64_inc(&st->cycles);
+}
+
+static int tom_stress_thread(void *data)
+{
+    struct tom_stress_worker *w = data;
+    unsigned int i;
+
+    for (i = 0; i < iterations && !kthread_should_stop(); i++) {
+        tom_stress_cycle(w->id, i);
+        cond_resched();
+    }
+
+    complete(&w->done);
+    return 0;
+}
+
+static int tom_stress_collect_pcms(void)
+{
+    struct snd_soc_card *card = tom_dummy_machine_get_card();
+    struct snd_soc_pcm_runtime *rtd;
+
+    if (!card)
+        return -ENODEV;
+
+    for_each_card_rtds(card, rtd) {
+        if (rtd->dai_link->no_pcm || !rtd->pcm)
+            continue;
+        if (tom_stress_num_pcms == TOM_STRESS_MAX_PCMS)
+            break;
+        tom_stress_pcms[tom_stress_num_pcms++] = rtd->pcm;
+    }
+
+    return tom_stress_num_pcms ? 0 : -ENODEV;
+}
+
+static int __init tom_dummy_stress_init(void)
+{
+    struct tom_stress_stats *st = &tom_stress_stats;
+    struct tom_stress_worker *workers;
+    bool locks_before = debug_locks;
+    bool kasan_before = test_taint(TAINT_BAD_PAGE);
+    unsigned int n, i, cpu;
+    ktime_t t0;
+    s64 elapsed_ns;
+    u64 cycles, teardowns;
+    struct tom_dummy_cancel_stats cancel;
+    int ret;
+
+    pr_info("tom_stress: init\n");
+
+    ret = tom_stress_collect_pcms();
+    if (ret) {
+        pr_err("tom_stress: card not ready: %d\n", ret);
+        return ret;
+    }
+
+    /* Only count the timer cancels of this run */
+    tom_dummy_platform_get_cancel_stats(&cancel, true);
+
+    n = threads ? threads : num_online_cpus();
+    workers = kcalloc(n, sizeof(*workers), GFP_KERNEL);
+    if (!workers)
+        return -ENOMEM;
+
+    t0 = ktime_get();
+
+    cpu = cpumask_first(cpu_online_mask);
+    for (i = 0; i < n; i++) {
+        struct tom_stress_worker *w = &workers[i];
+
+        w->id = i;
+        init_completion(&w->done);
+        w->task = kthread_create(tom_stress_thread, w, "tom_stress/%u", i);
+        if (IS_ERR(w->task)) {
+            ret = PTR_ERR(w->task);
+            w->task = NULL;
+            complete(&w->done);
+            continue;
+        }
+        kthread_bind(w->task, cpu);
+        wake_up_process(w->task);
+
+        cpu = cpumask_next(cpu, cpu_online_mask);
+        if (cpu >= nr_cpu_ids)
+            cpu = cpumask_first(cpu_online_mask);
+    }
+
+    for (i = 0; i < n; i++)
+        wait_for_completion(&workers[i].done);
+
+    elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+    kfree(workers);
+
+    cycles = atomic64_read(&st->cycles);
+    teardowns = cycles + atomic64_read(&st->errors);
+
+    pr_info("tom_stress: %u workers x %u iterations on %u PCMs in %lld ms\n",
+        n, iterations, tom_stress_num_pcms, div_s64(elapsed_ns, NSEC_PER_MSEC));
+    pr_info("tom_stress: cycles=%llu busy=%lld errors=%lld (%llu ops/s)\n",
+        cycles, atomic64_read(&st->busy), atomic64_read(&st->errors),
+        elapsed_ns ? div64_u64(cycles * NSEC_PER_SEC, elapsed_ns) : 0);
+    tom_dummy_platform_get_cancel_stats(&cancel, false);
+    pr_info("tom_stress: timer cancel (hw_free/close) n=%llu avg=%llu ns max=%llu ns\n",
+        cancel.count,
+        cancel.count ? div64_u64(cancel.total_ns, cancel.count) : 0,
+        cancel.max_ns);
+    pr_info("tom_stress: whole teardown (release incl. DPCM/DAPM) avg=%llu ns max=%lld ns\n",
+        teardowns ? div64_u64(atomic64_read(&st->teardown_ns), teardowns) : 0,
+        atomic64_read(&st->teardown_max_ns));
+    pr_info("tom_stress: lockdep %s, KASAN %s\n",
+        locks_before && !debug_locks ? "REPORTED A PROBLEM" : "clean",
+        !kasan_before && test_taint(TAINT_BAD_PAGE) ? "REPORTED A PROBLEM" : "clean");
+
+    return ret;
+}
+
+static void __exit tom_dummy_stress_exit(void)
+{
+    pr_info("tom_stress: exit\n");
+}
+
+module_init(tom_dummy_stress_init);
+module_exit(tom_dummy_stress_exit);
+
+MODULE_DESCRIPTION("Tom Dummy PCM engine lifecycle stress test");
+MODULE_AUTHOR("Tom Hsieh");
+MODULE_LICENSE("GPL");